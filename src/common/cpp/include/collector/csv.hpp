@@ -0,0 +1,116 @@
+#pragma once
+#if !defined(COLLECTOR_CSV_HPP_)
+#define COLLECTOR_CSV_HPP_
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+
+#include "sample_statistics.hpp"
+#include "collector/json.hpp"
+
+/* Collector streaming CSV in long form, so that every row of a stream has the same columns whatever the metrics of each */
+/* benchmark: benchmark name, run number (counting sets of sample results), record (trial or summary), trial number and */
+/* warmup flag (empty for summaries), and the name and value of one measure; each trial (warmup trials included) gives */
+/* its seconds and then each per-trial metric, written and flushed as the trial ends, and each set of sample results */
+/* gives the summary statistics (named as in JSON output), following the header written once at the start of the stream */
+class csv_output
+{
+public:
+	typedef boost::chrono::nanoseconds time_unit;
+
+public:
+	csv_output(std::string const& benchmark) :
+		benchmark_(benchmark),
+		run_(1)
+	{
+		std::cout << "benchmark,run,record,trial,warmup,name,value" << std::endl;
+	}
+
+public:
+	void register_exception(std::exception const& e)
+	{
+		std::cerr << "[ERROR] " << e.what() << std::endl;
+	}
+
+	/* Names the benchmark of the results that follow */
+	void set_benchmark(std::string const& benchmark)
+	{
+		benchmark_ = benchmark;
+	}
+
+	/* Records a value of a named metric for the trial in progress */
+	void register_trial_metric(char const* name, double value)
+	{
+		metrics_.push_back(std::make_pair(std::string(name), value));
+	}
+
+	void register_trial(int trial, time_unit sample, bool warmup)
+	{
+		std::ostringstream prefix;
+		prefix << quoted(benchmark_) << "," << run_ << ",trial," << trial << "," << (warmup ? 1 : 0) << ",";
+
+		std::cout << prefix.str() << "seconds," << chrono_formatter<time_unit>(sample) << "\n";
+
+		for (size_t i = 0; i < metrics_.size(); ++i)
+		{
+			std::cout << prefix.str() << quoted(metrics_[i].first) << "," << boost::format("%0.12g") % metrics_[i].second << "\n";
+		}
+
+		std::cout << std::flush;
+		metrics_.clear();
+	}
+
+	void register_sample_results(sample_statistics<time_unit> const& statistics)
+	{
+		report_results(statistics);
+
+		std::ostringstream prefix;
+		prefix << quoted(benchmark_) << "," << run_ << ",summary,,,";
+
+		std::cout << prefix.str() << "trial_count," << statistics.count() << "\n" <<
+			prefix.str() << "warmup_count," << statistics.warmup_count() << "\n" <<
+			prefix.str() << "total_seconds," << chrono_formatter<time_unit>(statistics.total()) << "\n" <<
+			prefix.str() << "min_seconds," << chrono_formatter<time_unit>(statistics.minimum()) << "\n" <<
+			prefix.str() << "max_seconds," << chrono_formatter<time_unit>(statistics.maximum()) << "\n" <<
+			prefix.str() << "mean_seconds," << chrono_formatter<time_unit>(statistics.mean()) << "\n" <<
+			prefix.str() << "median_seconds," << chrono_formatter<time_unit>(statistics.median()) << "\n" <<
+			prefix.str() << "stddev_seconds," << chrono_formatter<time_unit>(statistics.standard_deviation()) << "\n" <<
+			prefix.str() << "p90_seconds," << chrono_formatter<time_unit>(statistics.p90()) << "\n" <<
+			prefix.str() << "p99_seconds," << chrono_formatter<time_unit>(statistics.p99()) << "\n" <<
+			prefix.str() << "median_ci95_low_seconds," << chrono_formatter<time_unit>(statistics.median_low()) << "\n" <<
+			prefix.str() << "median_ci95_high_seconds," << chrono_formatter<time_unit>(statistics.median_high()) << std::endl;
+
+		++run_;
+	}
+
+private:
+	/* Field as written, quoted (with quotes doubled) if it contains a separator, quote or line break */
+	static std::string quoted(std::string const& field)
+	{
+		if (field.find_first_of(",\"\r\n") == std::string::npos)
+		{
+			return field;
+		}
+
+		std::string result("\"");
+
+		for (size_t i = 0; i < field.size(); ++i)
+		{
+			result += (field[i] == '"') ? std::string("\"\"") : std::string(1, field[i]);
+		}
+
+		return result + "\"";
+	}
+
+private:
+	std::string benchmark_;
+	int run_;
+	std::vector<std::pair<std::string, double> > metrics_;
+};
+
+#endif /* !COLLECTOR_CSV_HPP_ */
@@ -0,0 +1,84 @@
+#pragma once
+#if !defined(COLLECTOR_FORMATS_HPP_)
+#define COLLECTOR_FORMATS_HPP_
+
+#include <string>
+#include <stddef.h>
+#include <string.h>
+
+#include "collector/json.hpp"
+#include "collector/json_lines.hpp"
+#include "collector/csv.hpp"
+#include "collector/google_benchmark.hpp"
+
+/* Collectors provide a time_unit, and receive (outside the timed region of each trial) any exception ending a run, */
+/* per-trial metrics as they are registered, each trial once it ends (warmup trials included) via register_trial, and */
+/* the statistics of each set of samples; each writes its results to stdout in its own format, under a benchmark name */
+/* that may be changed between sets of samples via set_benchmark */
+namespace output_format
+{
+	typedef enum
+	{
+		json = 0,
+		json_lines = 1,
+		csv = 2,
+		google_benchmark = 3
+	}
+	format;
+
+	/* Parse a format name as given on the command line (returning false if unrecognized) */
+	inline bool parse(char const* name, format& result)
+	{
+		static char const* const names[] = { "json", "jsonl", "csv", "gbench" };
+
+		for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+		{
+			if (!strcmp(name, names[i]))
+			{
+				result = static_cast<format>(i);
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
+
+/* Calls a function (generic over the collector type) with a collector for the given format, naming the benchmark for */
+/* the formats that record it */
+template <class FUNCTION>
+void with_collector(output_format::format format, std::string const& benchmark, FUNCTION const& function)
+{
+	switch (format)
+	{
+	case output_format::json_lines:
+		{
+			json_lines_output collector(benchmark);
+			function(collector);
+		}
+		break;
+
+	case output_format::csv:
+		{
+			csv_output collector(benchmark);
+			function(collector);
+		}
+		break;
+
+	case output_format::google_benchmark:
+		{
+			google_benchmark_output collector(benchmark);
+			function(collector);
+		}
+		break;
+
+	default:
+		{
+			json_output collector;
+			function(collector);
+		}
+		break;
+	}
+}
+
+#endif /* !COLLECTOR_FORMATS_HPP_ */
@@ -0,0 +1,179 @@
+#pragma once
+#if !defined(COLLECTOR_GOOGLE_BENCHMARK_HPP_)
+#define COLLECTOR_GOOGLE_BENCHMARK_HPP_
+
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+
+#include "sample_statistics.hpp"
+#include "collector/json.hpp"
+
+/* Collector writing Google Benchmark's JSON schema, as one document once the collector is destroyed (after all runs) */
+/* Each sampled trial is reported as an iteration run, with its per-trial metrics as user counters, followed by mean, */
+/* median and standard deviation aggregates; trials are timed by wall clock only, so CPU time repeats real time */
+class google_benchmark_output
+{
+public:
+	typedef boost::chrono::nanoseconds time_unit;
+
+public:
+	google_benchmark_output(std::string const& benchmark) :
+		benchmark_(benchmark),
+		run_(0),
+		repetition_(0)
+	{
+	}
+
+	~google_benchmark_output()
+	{
+		std::cout << "{\n  \"context\": " << context() << ",\n  \"benchmarks\": [";
+
+		for (size_t i = 0; i < entries_.size(); ++i)
+		{
+			std::cout << ((i > 0) ? "," : "") << "\n    " << entries_[i];
+		}
+
+		std::cout << "\n  ]\n}" << std::endl;
+	}
+
+	google_benchmark_output(google_benchmark_output const&) = delete;
+	google_benchmark_output& operator=(google_benchmark_output const&) = delete;
+
+public:
+	void register_exception(std::exception const& e)
+	{
+		std::cerr << "[ERROR] " << e.what() << std::endl;
+	}
+
+	/* Names the benchmark of the results that follow */
+	void set_benchmark(std::string const& benchmark)
+	{
+		benchmark_ = benchmark;
+		repetition_ = 0;
+	}
+
+	/* Records a value of a named per-trial metric (covering sampled trials only, i.e., the values registered last) */
+	void register_trial_metric(char const* name, double value)
+	{
+		std::vector<std::pair<std::string, std::vector<double> > >::iterator metric = metrics_.begin();
+
+		while ((metric != metrics_.end()) && (metric->first != name))
+		{
+			++metric;
+		}
+
+		if (metric == metrics_.end())
+		{
+			metrics_.push_back(std::make_pair(std::string(name), std::vector<double>()));
+			metric = metrics_.end() - 1;
+		}
+
+		metric->second.push_back(value);
+	}
+
+	/* Iterations are reported once all trials are run, so individual trials need not be recorded */
+	void register_trial(int trial, time_unit sample, bool warmup)
+	{
+	}
+
+	void register_sample_results(sample_statistics<time_unit> const& statistics)
+	{
+		/* Repeated runs of one benchmark are told apart by number */
+		std::string name = (repetition_ > 0) ? (boost::format("%s/run:%d") % benchmark_ % (repetition_ + 1)).str() : benchmark_;
+		size_t count = static_cast<size_t>(statistics.count());
+
+		report_results(statistics);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			std::ostringstream entry;
+
+			entry << "{" << common_fields(name, name, "iteration", count) <<
+				", \"repetition_index\": " << i << ", \"iterations\": 1, " << times(statistics.samples()[i]);
+
+			/* Values registered for warmup trials precede those of sampled trials, and are skipped */
+			for (size_t j = 0; j < metrics_.size(); ++j)
+			{
+				size_t first = metrics_[j].second.size() - std::min(metrics_[j].second.size(), count);
+
+				if (first + i < metrics_[j].second.size())
+				{
+					entry << ", \"" << metrics_[j].first << "\": " << boost::format("%0.12g") % metrics_[j].second[first + i];
+				}
+			}
+
+			entry << "}";
+			entries_.push_back(entry.str());
+		}
+
+		add_aggregate(name, "mean", count, statistics.mean());
+		add_aggregate(name, "median", count, statistics.median());
+		add_aggregate(name, "stddev", count, statistics.standard_deviation());
+
+		metrics_.clear();
+		++run_;
+		++repetition_;
+	}
+
+private:
+	void add_aggregate(std::string const& name, char const* aggregate, size_t count, time_unit time)
+	{
+		std::ostringstream entry;
+
+		entry << "{" << common_fields(name + "_" + aggregate, name, "aggregate", count) <<
+			", \"aggregate_name\": \"" << aggregate << "\", \"aggregate_unit\": \"time\", \"iterations\": " << count << ", " << times(time) << "}";
+		entries_.push_back(entry.str());
+	}
+
+	std::string common_fields(std::string const& name, std::string const& run_name, char const* run_type, size_t repetitions) const
+	{
+		std::ostringstream fields;
+
+		fields << "\"name\": \"" << name << "\", \"family_index\": " << run_ << ", \"per_family_instance_index\": 0, " <<
+			"\"run_name\": \"" << run_name << "\", \"run_type\": \"" << run_type << "\", " <<
+			"\"repetitions\": " << repetitions << ", \"threads\": 1";
+		return fields.str();
+	}
+
+	static std::string times(time_unit time)
+	{
+		std::ostringstream fields;
+
+		fields << "\"real_time\": " << time.count() << ", \"cpu_time\": " << time.count() << ", \"time_unit\": \"ns\"";
+		return fields.str();
+	}
+
+	static std::string context()
+	{
+		std::time_t now = std::time(0);
+		char date[32];
+		std::ostringstream fields;
+
+		std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+		fields << "{\"date\": \"" << date << "\", \"num_cpus\": " << std::max(1u, std::thread::hardware_concurrency()) << ", " <<
+#if defined(NDEBUG)
+			"\"library_build_type\": \"release\"}";
+#else
+			"\"library_build_type\": \"debug\"}";
+#endif /* NDEBUG */
+		return fields.str();
+	}
+
+private:
+	std::string benchmark_;
+	int run_;
+	int repetition_;
+	std::vector<std::pair<std::string, std::vector<double> > > metrics_;
+	std::vector<std::string> entries_;
+};
+
+#endif /* !COLLECTOR_GOOGLE_BENCHMARK_HPP_ */
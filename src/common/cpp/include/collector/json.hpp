@@ -2,9 +2,15 @@
 #if !defined(COLLECTOR_JSON_HPP_)
 #define COLLECTOR_JSON_HPP_
 
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
 #include <boost/chrono.hpp>
 #include <boost/format.hpp>
 
+#include "sample_statistics.hpp"
+
 namespace json_output_helpers
 {
 	template <typename TIME_UNIT>
@@ -32,6 +38,18 @@ namespace json_output_helpers
 		sink << boost::format("%0.12f") % boost::chrono::duration<double>(units).count();
 		return sink;
 	}
+
+	/* Summarizes sample results on the console (shared by all collectors, whatever they write to stdout) */
+	template <typename TIME_UNIT>
+	void report_results(sample_statistics<TIME_UNIT> const& statistics)
+	{
+		std::cerr << "[RESULTS] trial(s):    " << statistics.count() << " (after " << statistics.warmup_count() << " warmup trial(s))" << std::endl;
+		std::cerr << "[RESULTS] total time:  " << statistics.total() << std::endl;
+		std::cerr << "[RESULTS] min time:    " << statistics.minimum() << std::endl;
+		std::cerr << "[RESULTS] max time:    " << statistics.maximum() << std::endl;
+		std::cerr << "[RESULTS] median time: " << statistics.median() << " (95% CI " << statistics.median_low() << " to " << statistics.median_high() << ")" << std::endl;
+		std::cerr << "[RESULTS] std dev:     " << statistics.standard_deviation() << std::endl;
+	}
 }
 
 using namespace json_output_helpers;
@@ -47,19 +65,90 @@ public:
 		std::cerr << "[ERROR] " << e.what() << std::endl;
 	}
 
-	void register_sample_results(int trials, time_unit total, time_unit low, time_unit high)
+	/* Names the benchmark of the results that follow (results carry a benchmark field only once one is named) */
+	void set_benchmark(std::string const& benchmark)
+	{
+		benchmark_ = benchmark;
+	}
+
+	/* Records a value of a named per-trial metric, reported (in order of registration) as an array with the results */
+	/* (covering sampled trials only, i.e., the values registered last) */
+	void register_trial_metric(char const* name, double value)
+	{
+		std::vector<std::pair<std::string, std::vector<double> > >::iterator metric = metrics_.begin();
+
+		while ((metric != metrics_.end()) && (metric->first != name))
+		{
+			++metric;
+		}
+
+		if (metric == metrics_.end())
+		{
+			metrics_.push_back(std::make_pair(std::string(name), std::vector<double>()));
+			metric = metrics_.end() - 1;
+		}
+
+		metric->second.push_back(value);
+	}
+
+	/* Results are reported once all trials are run, so individual trials need not be recorded */
+	void register_trial(int trial, time_unit sample, bool warmup)
+	{
+	}
+
+	void register_sample_results(sample_statistics<time_unit> const& statistics)
 	{
-		std::cerr << "[RESULTS] trial(s):    " << trials << std::endl;
-		std::cerr << "[RESULTS] total time:  " << total  << std::endl;
-		std::cerr << "[RESULTS] min time:    " << low << std::endl;
-		std::cerr << "[RESULTS] max time:    " << high << std::endl;
-
-		std::cout << "{\"trial_count\": " << trials << ", " <<
-			"\"total_seconds\": " << chrono_formatter<time_unit>(total) << ", " <<
-			"\"min_seconds\": " << chrono_formatter<time_unit>(low) << ", " <<
-			"\"max_seconds\": " << chrono_formatter<time_unit>(high) << ", " <<
-			"\"mean_seconds\": " << chrono_formatter<time_unit>(total / trials) << " }" << std::endl;
+		report_results(statistics);
+
+		std::cout << "{";
+
+		if (!benchmark_.empty())
+		{
+			std::cout << "\"benchmark\": \"" << benchmark_ << "\", ";
+		}
+
+		std::cout << "\"trial_count\": " << statistics.count() << ", " <<
+			"\"warmup_count\": " << statistics.warmup_count() << ", " <<
+			"\"total_seconds\": " << chrono_formatter<time_unit>(statistics.total()) << ", " <<
+			"\"min_seconds\": " << chrono_formatter<time_unit>(statistics.minimum()) << ", " <<
+			"\"max_seconds\": " << chrono_formatter<time_unit>(statistics.maximum()) << ", " <<
+			"\"mean_seconds\": " << chrono_formatter<time_unit>(statistics.mean()) << ", " <<
+			"\"median_seconds\": " << chrono_formatter<time_unit>(statistics.median()) << ", " <<
+			"\"stddev_seconds\": " << chrono_formatter<time_unit>(statistics.standard_deviation()) << ", " <<
+			"\"p90_seconds\": " << chrono_formatter<time_unit>(statistics.p90()) << ", " <<
+			"\"p99_seconds\": " << chrono_formatter<time_unit>(statistics.p99()) << ", " <<
+			"\"median_ci95_seconds\": [" << chrono_formatter<time_unit>(statistics.median_low()) << ", " << chrono_formatter<time_unit>(statistics.median_high()) << "], " <<
+			"\"samples_seconds\": [";
+
+		for (size_t i = 0; i < statistics.samples().size(); ++i)
+		{
+			std::cout << ((i > 0) ? ", " : "") << chrono_formatter<time_unit>(statistics.samples()[i]);
+		}
+
+		std::cout << "]";
+
+		for (size_t i = 0; i < metrics_.size(); ++i)
+		{
+			std::cout << ", \"" << metrics_[i].first << "\": [";
+
+			/* Values registered for warmup trials precede those of sampled trials, and are dropped */
+			size_t first = metrics_[i].second.size() - std::min(metrics_[i].second.size(), static_cast<size_t>(statistics.count()));
+
+			for (size_t j = first; j < metrics_[i].second.size(); ++j)
+			{
+				std::cout << ((j > first) ? ", " : "") << boost::format("%0.12g") % metrics_[i].second[j];
+			}
+
+			std::cout << "]";
+		}
+
+		std::cout << " }" << std::endl;
+		metrics_.clear();
 	}
+
+private:
+	std::string benchmark_;
+	std::vector<std::pair<std::string, std::vector<double> > > metrics_;
 };
 
 #endif /* !COLLECTOR_JSON_HPP_ */
@@ -0,0 +1,88 @@
+#pragma once
+#if !defined(COLLECTOR_JSON_LINES_HPP_)
+#define COLLECTOR_JSON_LINES_HPP_
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+
+#include "sample_statistics.hpp"
+#include "collector/json.hpp"
+
+/* Collector streaming JSON Lines: a record per trial (warmup trials included), written and flushed as each trial ends, */
+/* and a summary record per set of sample results; records carry the benchmark name and a run number (counting sets of */
+/* sample results), and trial records carry the per-trial metrics registered during the trial */
+class json_lines_output
+{
+public:
+	typedef boost::chrono::nanoseconds time_unit;
+
+public:
+	json_lines_output(std::string const& benchmark) :
+		benchmark_(benchmark),
+		run_(1)
+	{
+	}
+
+public:
+	void register_exception(std::exception const& e)
+	{
+		std::cerr << "[ERROR] " << e.what() << std::endl;
+	}
+
+	/* Names the benchmark of the results that follow */
+	void set_benchmark(std::string const& benchmark)
+	{
+		benchmark_ = benchmark;
+	}
+
+	/* Records a value of a named metric for the trial in progress */
+	void register_trial_metric(char const* name, double value)
+	{
+		metrics_.push_back(std::make_pair(std::string(name), value));
+	}
+
+	void register_trial(int trial, time_unit sample, bool warmup)
+	{
+		std::cout << "{\"record\": \"trial\", \"benchmark\": \"" << benchmark_ << "\", \"run\": " << run_ << ", " <<
+			"\"trial\": " << trial << ", " <<
+			"\"warmup\": " << (warmup ? "true" : "false") << ", " <<
+			"\"seconds\": " << chrono_formatter<time_unit>(sample);
+
+		for (size_t i = 0; i < metrics_.size(); ++i)
+		{
+			std::cout << ", \"" << metrics_[i].first << "\": " << boost::format("%0.12g") % metrics_[i].second;
+		}
+
+		std::cout << "}" << std::endl;
+		metrics_.clear();
+	}
+
+	void register_sample_results(sample_statistics<time_unit> const& statistics)
+	{
+		report_results(statistics);
+
+		std::cout << "{\"record\": \"summary\", \"benchmark\": \"" << benchmark_ << "\", \"run\": " << run_++ << ", " <<
+			"\"trial_count\": " << statistics.count() << ", " <<
+			"\"warmup_count\": " << statistics.warmup_count() << ", " <<
+			"\"total_seconds\": " << chrono_formatter<time_unit>(statistics.total()) << ", " <<
+			"\"min_seconds\": " << chrono_formatter<time_unit>(statistics.minimum()) << ", " <<
+			"\"max_seconds\": " << chrono_formatter<time_unit>(statistics.maximum()) << ", " <<
+			"\"mean_seconds\": " << chrono_formatter<time_unit>(statistics.mean()) << ", " <<
+			"\"median_seconds\": " << chrono_formatter<time_unit>(statistics.median()) << ", " <<
+			"\"stddev_seconds\": " << chrono_formatter<time_unit>(statistics.standard_deviation()) << ", " <<
+			"\"p90_seconds\": " << chrono_formatter<time_unit>(statistics.p90()) << ", " <<
+			"\"p99_seconds\": " << chrono_formatter<time_unit>(statistics.p99()) << ", " <<
+			"\"median_ci95_seconds\": [" << chrono_formatter<time_unit>(statistics.median_low()) << ", " << chrono_formatter<time_unit>(statistics.median_high()) << "]}" << std::endl;
+	}
+
+private:
+	std::string benchmark_;
+	int run_;
+	std::vector<std::pair<std::string, double> > metrics_;
+};
+
+#endif /* !COLLECTOR_JSON_LINES_HPP_ */
@@ -0,0 +1,256 @@
+#pragma once
+#if !defined(COLLECTOR_PERF_COUNTERS_HPP_)
+#define COLLECTOR_PERF_COUNTERS_HPP_
+
+#include <iostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif /* __linux__ */
+
+#include "profile.hpp"
+
+/* Hardware performance counters of the calling thread and of threads it creates while counting (via Linux perf_event_open) */
+/* Each counter is opened independently, so any the kernel or hardware refuses (e.g., in virtual machines or when */
+/* perf_event_paranoid forbids it) are simply unavailable, as are all counters on other platforms; counts are scaled for */
+/* any time a counter was multiplexed off the hardware */
+class hardware_counters
+{
+public:
+	typedef enum
+	{
+		cycles = 0,
+		instructions = 1,
+		llc_misses = 2,
+		branch_misses = 3
+	}
+	counter;
+
+	static const size_t COUNTER_COUNT = 4;
+
+public:
+	hardware_counters()
+	{
+		for (size_t i = 0; i < COUNTER_COUNT; ++i)
+		{
+			descriptors_[i] = open_counter(static_cast<counter>(i));
+			values_[i] = 0;
+		}
+	}
+
+	~hardware_counters()
+	{
+#if defined(__linux__)
+		for (size_t i = 0; i < COUNTER_COUNT; ++i)
+		{
+			if (descriptors_[i] >= 0)
+			{
+				close(descriptors_[i]);
+			}
+		}
+#endif /* __linux__ */
+	}
+
+	hardware_counters(hardware_counters const&) = delete;
+	hardware_counters& operator=(hardware_counters const&) = delete;
+
+public:
+	static char const* name(counter which)
+	{
+		static char const* names[COUNTER_COUNT] = { "cycles", "instructions", "llc_misses", "branch_misses" };
+		return names[which];
+	}
+
+	bool available(counter which) const
+	{
+		return descriptors_[which] >= 0;
+	}
+
+	bool any_available() const
+	{
+		for (size_t i = 0; i < COUNTER_COUNT; ++i)
+		{
+			if (available(static_cast<counter>(i)))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void start()
+	{
+#if defined(__linux__)
+		for (size_t i = 0; i < COUNTER_COUNT; ++i)
+		{
+			if (descriptors_[i] >= 0)
+			{
+				ioctl(descriptors_[i], PERF_EVENT_IOC_RESET, 0);
+				ioctl(descriptors_[i], PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+#endif /* __linux__ */
+	}
+
+	void stop()
+	{
+#if defined(__linux__)
+		for (size_t i = 0; i < COUNTER_COUNT; ++i)
+		{
+			if (descriptors_[i] >= 0)
+			{
+				ioctl(descriptors_[i], PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+
+		for (size_t i = 0; i < COUNTER_COUNT; ++i)
+		{
+			/* Value, time enabled, and time running */
+			uint64_t reading[3] = { 0, 0, 0 };
+
+			if ((descriptors_[i] >= 0) && (read(descriptors_[i], reading, sizeof(reading)) == static_cast<ssize_t>(sizeof(reading))))
+			{
+				values_[i] = (reading[2] > 0) ? static_cast<uint64_t>(static_cast<double>(reading[0]) * reading[1] / reading[2]) : 0;
+			}
+		}
+#endif /* __linux__ */
+	}
+
+	/* Count between the last start and stop */
+	uint64_t value(counter which) const
+	{
+		return values_[which];
+	}
+
+private:
+	static int open_counter(counter which)
+	{
+#if defined(__linux__)
+		static uint64_t const configs[COUNTER_COUNT] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+		perf_event_attr attributes;
+
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.size = sizeof(attributes);
+		attributes.config = configs[which];
+		attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		attributes.disabled = 1;
+		attributes.inherit = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+
+		return static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+#else
+		return -1;
+#endif /* __linux__ */
+	}
+
+private:
+	int descriptors_[COUNTER_COUNT];
+	uint64_t values_[COUNTER_COUNT];
+};
+
+/* Collector counting hardware events around each sample, forwarding everything to another collector; each available */
+/* counter's delta is registered as a per-trial metric, along with instructions per cycle and, for subjects declaring */
+/* their floating-point work, bytes per flop (memory traffic estimated as a cache line per last-level cache miss) */
+template <class COLLECTOR>
+class perf_counter_collector
+{
+public:
+	typedef typename COLLECTOR::time_unit time_unit;
+
+	static const size_t CACHE_LINE_BYTES = 64;
+
+public:
+	perf_counter_collector(COLLECTOR& output) :
+		output_(output)
+	{
+		if (!counters_.any_available())
+		{
+			std::cerr << "[PROGRESS] hardware counters are unavailable (continuing without them)" << std::endl;
+		}
+	}
+
+public:
+	void register_exception(std::exception const& e)
+	{
+		output_.register_exception(e);
+	}
+
+	void register_trial_metric(char const* name, double value)
+	{
+		output_.register_trial_metric(name, value);
+	}
+
+	void register_trial(int trial, time_unit sample, bool warmup)
+	{
+		output_.register_trial(trial, sample, warmup);
+	}
+
+	void register_sample_results(sample_statistics<time_unit> const& statistics)
+	{
+		output_.register_sample_results(statistics);
+	}
+
+	void start_sample()
+	{
+		counters_.start();
+	}
+
+	/* Registers the counts of a sample, given its floating-point operations (or zero if unknown) */
+	void stop_sample(double flops)
+	{
+		counters_.stop();
+
+		for (size_t i = 0; i < hardware_counters::COUNTER_COUNT; ++i)
+		{
+			hardware_counters::counter which = static_cast<hardware_counters::counter>(i);
+
+			if (counters_.available(which))
+			{
+				output_.register_trial_metric(hardware_counters::name(which), static_cast<double>(counters_.value(which)));
+			}
+		}
+
+		if (counters_.available(hardware_counters::cycles) && counters_.available(hardware_counters::instructions))
+		{
+			uint64_t cycles = counters_.value(hardware_counters::cycles);
+			output_.register_trial_metric("ipc", (cycles > 0) ? static_cast<double>(counters_.value(hardware_counters::instructions)) / cycles : 0.0);
+		}
+
+		if (counters_.available(hardware_counters::llc_misses) && (flops > 0.0))
+		{
+			output_.register_trial_metric("bytes_per_flop", static_cast<double>(counters_.value(hardware_counters::llc_misses)) * CACHE_LINE_BYTES / flops);
+		}
+	}
+
+private:
+	COLLECTOR& output_;
+	hardware_counters counters_;
+};
+
+/* Runs a profiler over a subject, counting hardware events around each sample if requested */
+template <class SUBJECT, class COLLECTOR, class ... SUBJECT_ARGUMENTS>
+void run_profiler(sampling_policy const& policy, bool count_events, COLLECTOR& collector, SUBJECT_ARGUMENTS ... subject_arguments)
+{
+	if (count_events)
+	{
+		perf_counter_collector<COLLECTOR> counting_collector(collector);
+		profiler<SUBJECT, perf_counter_collector<COLLECTOR> > metrics(policy, counting_collector, subject_arguments ...);
+		metrics.run();
+	}
+	else
+	{
+		profiler<SUBJECT, COLLECTOR> metrics(policy, collector, subject_arguments ...);
+		metrics.run();
+	}
+}
+
+#endif /* !COLLECTOR_PERF_COUNTERS_HPP_ */
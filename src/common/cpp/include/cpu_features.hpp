@@ -0,0 +1,85 @@
+#pragma once
+#if !defined(CPU_FEATURES_HPP_)
+#define CPU_FEATURES_HPP_
+
+/* Runtime detection of instruction set support (x86 only), for dispatch to kernels compiled for specific targets */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define CPU_FEATURES_AVAILABLE
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif /* _MSC_VER */
+
+/* Compiles a function for a given target (e.g., "avx2") regardless of command line options (MSVC needs no attribute) */
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_TARGET(ISA) __attribute__((target(ISA)))
+#else
+#define CPU_TARGET(ISA)
+#endif /* __GNUC__ || __clang__ */
+
+class cpu_features
+{
+public:
+	static bool has_popcnt()
+	{
+#if defined(_MSC_VER)
+		int registers[4];
+		__cpuid(registers, 1);
+		return (registers[2] & (1 << 23)) != 0;
+#else
+		return __builtin_cpu_supports("popcnt");
+#endif /* _MSC_VER */
+	}
+
+	static bool has_avx2()
+	{
+#if defined(_MSC_VER)
+		int registers[4];
+		__cpuidex(registers, 7, 0);
+		return os_saves_ymm() && ((registers[1] & (1 << 5)) != 0);
+#else
+		return __builtin_cpu_supports("avx2");
+#endif /* _MSC_VER */
+	}
+
+	static bool has_avx512f()
+	{
+#if defined(_MSC_VER)
+		int registers[4];
+		__cpuidex(registers, 7, 0);
+		return os_saves_zmm() && ((registers[1] & (1 << 16)) != 0);
+#else
+		return __builtin_cpu_supports("avx512f");
+#endif /* _MSC_VER */
+	}
+
+	static bool has_avx512vpopcntdq()
+	{
+#if defined(_MSC_VER)
+		int registers[4];
+		__cpuidex(registers, 7, 0);
+		return has_avx512f() && ((registers[2] & (1 << 14)) != 0);
+#else
+		return has_avx512f() && __builtin_cpu_supports("avx512vpopcntdq");
+#endif /* _MSC_VER */
+	}
+
+#if defined(_MSC_VER)
+private:
+	static bool os_saves_ymm()
+	{
+		int registers[4];
+		__cpuid(registers, 1);
+		return ((registers[2] & (1 << 27)) != 0) && ((_xgetbv(0) & 0x06) == 0x06);
+	}
+
+	static bool os_saves_zmm()
+	{
+		return os_saves_ymm() && ((_xgetbv(0) & 0xe6) == 0xe6);
+	}
+#endif /* _MSC_VER */
+};
+
+#endif /* x86 */
+
+#endif /* !CPU_FEATURES_HPP_ */
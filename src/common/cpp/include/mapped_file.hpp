@@ -0,0 +1,85 @@
+#pragma once
+#if !defined(MAPPED_FILE_HPP_)
+#define MAPPED_FILE_HPP_
+
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define MAPPED_FILE_ADVICE_AVAILABLE
+#endif /* __unix__ || __APPLE__ */
+
+/* Read-only view of an entire input file mapped into memory (an empty file yields an empty view, as it can't be mapped) */
+class mapped_data_file
+{
+public:
+	mapped_data_file(char const* filename)
+	{
+		boost::system::error_code status;
+
+		if ((boost::filesystem::file_size(filename, status) == 0) && (status == boost::system::errc::success))
+		{
+			return;
+		}
+
+		try
+		{
+			/* The region remains valid after the file mapping object itself goes out of scope */
+			boost::interprocess::file_mapping mapping(filename, boost::interprocess::read_only);
+			boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+			region.advise(boost::interprocess::mapped_region::advice_sequential);
+			region_.swap(region);
+		}
+		catch (boost::interprocess::interprocess_exception const&)
+		{
+			throw std::runtime_error("Failed to open source data file");
+		}
+	}
+
+	char const* begin() const
+	{
+		return static_cast<char const*>(region_.get_address());
+	}
+
+	char const* end() const
+	{
+		return begin() + region_.get_size();
+	}
+
+	/* Hints that a range of the file will be read soon (where supported) */
+	void prefetch(char const* first, char const* last) const
+	{
+		advise(first, last, true);
+	}
+
+	/* Hints that a range of the file won't be read again soon, so that its pages may be reclaimed (where supported) */
+	void release(char const* first, char const* last) const
+	{
+		advise(first, last, false);
+	}
+
+private:
+	void advise(char const* first, char const* last, bool needed) const
+	{
+#if defined(MAPPED_FILE_ADVICE_AVAILABLE)
+		/* Advice applies to whole pages, so the range is widened to page boundaries */
+		size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		char* aligned = const_cast<char*>(begin()) + (first - begin()) / page * page;
+
+		if (last > aligned)
+		{
+			posix_madvise(aligned, last - aligned, needed ? POSIX_MADV_WILLNEED : POSIX_MADV_DONTNEED);
+		}
+#endif /* MAPPED_FILE_ADVICE_AVAILABLE */
+	}
+
+private:
+	boost::interprocess::mapped_region region_;
+};
+
+#endif /* !MAPPED_FILE_HPP_ */
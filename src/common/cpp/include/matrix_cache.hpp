@@ -0,0 +1,604 @@
+#pragma once
+#if !defined(MATRIX_CACHE_HPP_)
+#define MATRIX_CACHE_HPP_
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <boost/numeric/ublas/matrix_sparse.hpp>
+
+#include "mapped_file.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#define MATRIX_CACHE_STAT_AVAILABLE
+#endif /* __unix__ || __APPLE__ */
+
+/* Binary cache for matrix inputs parsed from text, used only once a cache directory is set (e.g., via --cache) */
+/* A cache file is written to the cache directory after text is parsed, named after the first source file and a hash of */
+/* its absolute path (e.g., "v.csv.0123456789abcdef.f64.mcache"), and is preferred over the text on later loads for as */
+/* long as the size and modification time (to the nanosecond, where the platform records it) of every source are */
+/* unchanged; sources modified within MATRIX_CACHE_SETTLE_SECONDS aren't cached, so that an edit made within the */
+/* resolution of a coarse file system clock can't go unnoticed */
+
+#if !defined(MATRIX_CACHE_SETTLE_SECONDS)
+#define MATRIX_CACHE_SETTLE_SECONDS 2
+#endif /* !MATRIX_CACHE_SETTLE_SECONDS */
+
+namespace cache_layout
+{
+	typedef enum
+	{
+		dense = 1,
+		compressed_row = 2
+	}
+	layout;
+}
+
+/* Element type identification for cache files (only floating-point element types are supported) */
+template <typename VALUE_TYPE>
+class matrix_cache_dtype
+{
+};
+
+template <>
+class matrix_cache_dtype<double>
+{
+public:
+	static const uint32_t code = 1;
+
+	static char const* suffix()
+	{
+		return ".f64.mcache";
+	}
+};
+
+template <>
+class matrix_cache_dtype<float>
+{
+public:
+	static const uint32_t code = 2;
+
+	static char const* suffix()
+	{
+		return ".f32.mcache";
+	}
+};
+
+/* Leading portion of a cache file, followed by one stamp per source file and then by the payload */
+/* The payload begins at the first multiple of MATRIX_CACHE_ALIGNMENT following the stamps */
+/* A dense payload holds rows x columns values in row-major order */
+/* A compressed row payload holds (rows + 1) row offsets and nnz column indices (each as uint64_t), followed by nnz values */
+struct matrix_cache_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t dtype;
+	uint32_t layout;
+	uint64_t rows;
+	uint64_t columns;
+	uint64_t nnz;
+	uint64_t payload_size;
+	uint64_t checksum;
+	uint32_t source_count;
+	uint32_t reserved;
+};
+
+/* Identity of a source file at the time its content was cached (modification time in nanoseconds since the epoch) */
+struct matrix_cache_stamp
+{
+	uint64_t size;
+	int64_t modified;
+};
+
+/* Directory holding cache files (empty by default, which disables caching) */
+inline std::string& matrix_cache_directory()
+{
+	static std::string directory;
+	return directory;
+}
+
+static char const MATRIX_CACHE_MAGIC[8] = { 'M', 'T', 'X', 'C', 'A', 'C', 'H', 'E' };
+static const uint32_t MATRIX_CACHE_VERSION = 2;
+static const uint32_t MATRIX_CACHE_BYTE_ORDER = 0x01020304;
+static const size_t MATRIX_CACHE_ALIGNMENT = 64;
+
+/* Incremental 64-bit checksum over cache payload (FNV-style mixing of 8-byte words) */
+class matrix_cache_checksum
+{
+public:
+	matrix_cache_checksum() :
+		state_(0xcbf29ce484222325ULL),
+		pending_(0),
+		pending_size_(0),
+		total_size_(0)
+	{
+	}
+
+	void update(void const* data, size_t size)
+	{
+		unsigned char const* bytes = static_cast<unsigned char const*>(data);
+
+		total_size_ += size;
+
+		/* Complete any partial word left over from a previous update */
+		while ((pending_size_ > 0) && (size > 0))
+		{
+			pending_ |= static_cast<uint64_t>(*bytes++) << (8 * pending_size_++);
+			--size;
+
+			if (pending_size_ == sizeof(uint64_t))
+			{
+				mix(pending_);
+				pending_ = 0;
+				pending_size_ = 0;
+			}
+		}
+
+		for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t))
+		{
+			uint64_t word;
+			memcpy(&word, bytes, sizeof(word));
+			mix(word);
+		}
+
+		while (size-- > 0)
+		{
+			pending_ |= static_cast<uint64_t>(*bytes++) << (8 * pending_size_++);
+		}
+	}
+
+	uint64_t value() const
+	{
+		matrix_cache_checksum snapshot(*this);
+		snapshot.mix(snapshot.pending_);
+		snapshot.mix(snapshot.total_size_);
+		return snapshot.state_;
+	}
+
+private:
+	void mix(uint64_t word)
+	{
+		state_ = (state_ ^ word) * 0x100000001b3ULL;
+		state_ ^= state_ >> 29;
+	}
+
+private:
+	uint64_t state_;
+	uint64_t pending_;
+	size_t pending_size_;
+	uint64_t total_size_;
+};
+
+/* Cache for the content of one chain of source files, loaded as a matrix with a given element type */
+/* Failures while writing a cache are not fatal (the cache is simply not available on the next load) */
+template <typename VALUE_TYPE>
+class matrix_cache
+{
+public:
+	matrix_cache(char const* const* filename_ptr, char const* const* filename_sentinel) :
+		enabled_(!matrix_cache_directory().empty())
+	{
+#if defined(DISABLE_MATRIX_CACHE)
+		enabled_ = false;
+#else
+		if (!enabled_)
+		{
+			return;
+		}
+
+		boost::system::error_code status;
+		boost::filesystem::path source(boost::filesystem::absolute(*filename_ptr));
+		matrix_cache_checksum source_hash;
+
+		source_hash.update(source.string().data(), source.string().size());
+		path_ = (boost::filesystem::path(matrix_cache_directory()) / source.filename()).string();
+		path_ += (boost::format(".%016x") % source_hash.value()).str();
+		path_ += matrix_cache_dtype<VALUE_TYPE>::suffix();
+
+		int64_t settled = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count() -
+			static_cast<int64_t>(MATRIX_CACHE_SETTLE_SECONDS) * 1000000000;
+
+		for (; filename_ptr < filename_sentinel; ++filename_ptr)
+		{
+			matrix_cache_stamp stamp;
+
+			stamp.size = boost::filesystem::file_size(*filename_ptr, status);
+
+			/* Without a stamp for every source, freshness can't be established (nor for a source that may yet be edited */
+			/* within the resolution of its modification time) */
+			if ((status != boost::system::errc::success) || !modified(*filename_ptr, stamp.modified) || (stamp.modified > settled))
+			{
+				enabled_ = false;
+				break;
+			}
+
+			stamps_.push_back(stamp);
+		}
+#endif /* DISABLE_MATRIX_CACHE */
+	}
+
+public:
+	/* Populates a matrix from a fresh dense cache (returning false if no such cache is available) */
+	template <class MATRIX_TYPE>
+	bool load_dense(MATRIX_TYPE& matrix) const
+	{
+		typedef typename MATRIX_TYPE::size_type index_type;
+
+		matrix_cache_header header;
+		std::unique_ptr<mapped_data_file> source(open(cache_layout::dense, header));
+
+		if (!source)
+		{
+			return false;
+		}
+
+		VALUE_TYPE const* values = reinterpret_cast<VALUE_TYPE const*>(source->begin() + payload_offset());
+
+		matrix.resize(header.rows, header.columns, false);
+
+		for (index_type i = 0; i < header.rows; ++i)
+		{
+			for (index_type j = 0; j < header.columns; ++j)
+			{
+				matrix(i, j) = *values++;
+			}
+		}
+
+		return true;
+	}
+
+	/* Writes a dense cache for a matrix just populated from its sources */
+	template <class MATRIX_TYPE>
+	void store_dense(MATRIX_TYPE const& matrix) const
+	{
+		typedef typename MATRIX_TYPE::size_type index_type;
+
+		if (!enabled_)
+		{
+			return;
+		}
+
+		cache_writer writer(*this);
+		std::vector<VALUE_TYPE> row(matrix.size2());
+
+		for (index_type i = 0; i < matrix.size1(); ++i)
+		{
+			for (index_type j = 0; j < matrix.size2(); ++j)
+			{
+				row[j] = matrix(i, j);
+			}
+
+			writer.write(row);
+		}
+
+		writer.commit(cache_layout::dense, matrix.size1(), matrix.size2(), matrix.size1() * matrix.size2());
+	}
+
+	/* Maps a fresh dense cache for direct access to its values in row-major order (returning NULL if no such cache is available) */
+	mapped_data_file* map_dense(VALUE_TYPE const*& values, uint64_t& rows, uint64_t& columns) const
+	{
+		matrix_cache_header header;
+		mapped_data_file* source = open(cache_layout::dense, header);
+
+		if (source != NULL)
+		{
+			values = reinterpret_cast<VALUE_TYPE const*>(source->begin() + payload_offset());
+			rows = header.rows;
+			columns = header.columns;
+		}
+
+		return source;
+	}
+
+	/* Populates a coordinate matrix from a fresh compressed row cache (returning false if no such cache is available) */
+	bool load_sparse(boost::numeric::ublas::coordinate_matrix<VALUE_TYPE>& matrix) const
+	{
+		matrix_cache_header header;
+		std::unique_ptr<mapped_data_file> source(open(cache_layout::compressed_row, header));
+
+		if (!source)
+		{
+			return false;
+		}
+
+		uint64_t const* row_offsets = reinterpret_cast<uint64_t const*>(source->begin() + payload_offset());
+		uint64_t const* column_indices = row_offsets + header.rows + 1;
+		VALUE_TYPE const* values = reinterpret_cast<VALUE_TYPE const*>(column_indices + header.nnz);
+
+		matrix.resize(header.rows, header.columns, false);
+		matrix.reserve(header.nnz, false);
+
+		/* Elements arrive in sorted order, so they are appended without requiring a later sort */
+		for (uint64_t i = 0; i < header.rows; ++i)
+		{
+			for (uint64_t k = row_offsets[i]; k < row_offsets[i + 1]; ++k)
+			{
+				matrix.push_back(i, column_indices[k], values[k]);
+			}
+		}
+
+		return true;
+	}
+
+	/* Writes a compressed row cache for a matrix just populated from its sources */
+	template <class MATRIX_TYPE>
+	void store_sparse(MATRIX_TYPE const& matrix) const
+	{
+		if (!enabled_)
+		{
+			return;
+		}
+
+		std::vector<uint64_t> row_offsets(matrix.size1() + 1, 0);
+		std::vector<uint64_t> column_indices;
+		std::vector<VALUE_TYPE> values;
+
+		/* Const iteration visits (sorted) elements in row-major order */
+		for (typename MATRIX_TYPE::const_iterator1 major = matrix.begin1(); major != matrix.end1(); ++major)
+		{
+			for (typename MATRIX_TYPE::const_iterator2 minor = major.begin(); minor != major.end(); ++minor)
+			{
+				++row_offsets[minor.index1() + 1];
+				column_indices.push_back(minor.index2());
+				values.push_back(*minor);
+			}
+		}
+
+		for (size_t i = 0; i < matrix.size1(); ++i)
+		{
+			row_offsets[i + 1] += row_offsets[i];
+		}
+
+		cache_writer writer(*this);
+		writer.write(row_offsets);
+		writer.write(column_indices);
+		writer.write(values);
+		writer.commit(cache_layout::compressed_row, matrix.size1(), matrix.size2(), values.size());
+	}
+
+	/* Whether caches are used (false if disabled at build time, if no cache directory is set, or if any source can't be */
+	/* stamped or was modified too recently) */
+	bool enabled() const
+	{
+		return enabled_;
+	}
+
+private:
+	/* Helper for writing a cache file under a temporary name and renaming it into place once complete */
+	class cache_writer
+	{
+	public:
+		cache_writer(matrix_cache const& cache) :
+			cache_(cache),
+			temporary_(cache.path_ + ".tmp"),
+			sink_(temporary_.c_str(), std::ios::binary | std::ios::trunc),
+			payload_size_(0)
+		{
+			/* Header is rewritten with final content when committed */
+			std::vector<char> padding(cache_.payload_offset(), 0);
+			sink_.write(&padding[0], padding.size());
+		}
+
+		~cache_writer()
+		{
+			if (sink_.is_open())
+			{
+				sink_.close();
+				boost::system::error_code status;
+				boost::filesystem::remove(temporary_, status);
+			}
+		}
+
+		template <typename ELEMENT_TYPE>
+		void write(std::vector<ELEMENT_TYPE> const& elements)
+		{
+			if (!elements.empty())
+			{
+				write(&elements[0], elements.size());
+			}
+		}
+
+		template <typename ELEMENT_TYPE>
+		void write(ELEMENT_TYPE const* elements, size_t count)
+		{
+			sink_.write(reinterpret_cast<char const*>(elements), count * sizeof(ELEMENT_TYPE));
+			checksum_.update(elements, count * sizeof(ELEMENT_TYPE));
+			payload_size_ += count * sizeof(ELEMENT_TYPE);
+		}
+
+		void commit(cache_layout::layout layout, uint64_t rows, uint64_t columns, uint64_t nnz)
+		{
+			matrix_cache_header header;
+
+			memset(&header, 0, sizeof(header));
+			memcpy(header.magic, MATRIX_CACHE_MAGIC, sizeof(header.magic));
+			header.version = MATRIX_CACHE_VERSION;
+			header.byte_order = MATRIX_CACHE_BYTE_ORDER;
+			header.dtype = matrix_cache_dtype<VALUE_TYPE>::code;
+			header.layout = layout;
+			header.rows = rows;
+			header.columns = columns;
+			header.nnz = nnz;
+			header.payload_size = payload_size_;
+			header.checksum = checksum_.value();
+			header.source_count = static_cast<uint32_t>(cache_.stamps_.size());
+
+			sink_.seekp(0);
+			sink_.write(reinterpret_cast<char const*>(&header), sizeof(header));
+			sink_.write(reinterpret_cast<char const*>(&cache_.stamps_[0]), cache_.stamps_.size() * sizeof(matrix_cache_stamp));
+			sink_.close();
+
+			boost::system::error_code status;
+
+			if (sink_.fail())
+			{
+				boost::filesystem::remove(temporary_, status);
+				return;
+			}
+
+			boost::filesystem::rename(temporary_, cache_.path_, status);
+
+			if (status != boost::system::errc::success)
+			{
+				boost::filesystem::remove(temporary_, status);
+			}
+		}
+
+	private:
+		matrix_cache const& cache_;
+		std::string temporary_;
+		std::ofstream sink_;
+		matrix_cache_checksum checksum_;
+		uint64_t payload_size_;
+	};
+
+public:
+	/* Writer for a dense cache whose rows are produced one at a time, so that sources too large for memory may be cached */
+	/* (all rows must have the same number of columns; nothing is written if caching is disabled) */
+	class dense_row_writer
+	{
+	public:
+		dense_row_writer(matrix_cache const& cache) :
+			writer_(cache.enabled_ ? new cache_writer(cache) : NULL),
+			rows_(0),
+			columns_(0)
+		{
+		}
+
+		void write(VALUE_TYPE const* values, size_t columns)
+		{
+			if (writer_)
+			{
+				writer_->write(values, columns);
+				columns_ = columns;
+				++rows_;
+			}
+		}
+
+		void commit()
+		{
+			if (writer_)
+			{
+				writer_->commit(cache_layout::dense, rows_, columns_, rows_ * columns_);
+				writer_.reset();
+			}
+		}
+
+	private:
+		std::unique_ptr<cache_writer> writer_;
+		uint64_t rows_;
+		uint64_t columns_;
+	};
+
+private:
+	/* Modification time of a file in nanoseconds since the epoch (in whole seconds where the platform records no finer time) */
+	static bool modified(char const* filename, int64_t& nanoseconds)
+	{
+#if defined(MATRIX_CACHE_STAT_AVAILABLE)
+		struct stat status;
+
+		if (stat(filename, &status) != 0)
+		{
+			return false;
+		}
+
+#if defined(__APPLE__)
+		nanoseconds = static_cast<int64_t>(status.st_mtimespec.tv_sec) * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+		nanoseconds = static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif /* __APPLE__ */
+		return true;
+#else
+		boost::system::error_code status;
+		std::time_t seconds = boost::filesystem::last_write_time(filename, status);
+
+		nanoseconds = static_cast<int64_t>(seconds) * 1000000000;
+		return status == boost::system::errc::success;
+#endif /* MATRIX_CACHE_STAT_AVAILABLE */
+	}
+
+	/* Offset of payload from start of file (header and stamps, padded for alignment) */
+	size_t payload_offset() const
+	{
+		size_t offset = sizeof(matrix_cache_header) + stamps_.size() * sizeof(matrix_cache_stamp);
+		return (offset + MATRIX_CACHE_ALIGNMENT - 1) / MATRIX_CACHE_ALIGNMENT * MATRIX_CACHE_ALIGNMENT;
+	}
+
+	/* Maps the cache file if it exists and is fresh, complete and intact (otherwise returns NULL) */
+	mapped_data_file* open(cache_layout::layout layout, matrix_cache_header& header) const
+	{
+		boost::system::error_code status;
+
+		if (!enabled_ || !boost::filesystem::exists(path_, status))
+		{
+			return NULL;
+		}
+
+		std::unique_ptr<mapped_data_file> source;
+
+		try
+		{
+			source.reset(new mapped_data_file(path_.c_str()));
+		}
+		catch (std::runtime_error const&)
+		{
+			return NULL;
+		}
+
+		size_t available = source->end() - source->begin();
+
+		if (available < payload_offset())
+		{
+			return NULL;
+		}
+
+		memcpy(&header, source->begin(), sizeof(header));
+
+		if ((memcmp(header.magic, MATRIX_CACHE_MAGIC, sizeof(header.magic)) != 0) ||
+			(header.version != MATRIX_CACHE_VERSION) ||
+			(header.byte_order != MATRIX_CACHE_BYTE_ORDER) ||
+			(header.dtype != matrix_cache_dtype<VALUE_TYPE>::code) ||
+			(header.layout != static_cast<uint32_t>(layout)) ||
+			(header.source_count != stamps_.size()) ||
+			(memcmp(source->begin() + sizeof(header), &stamps_[0], stamps_.size() * sizeof(matrix_cache_stamp)) != 0))
+		{
+			return NULL;
+		}
+
+		uint64_t expected_size = (layout == cache_layout::dense) ?
+			(header.rows * header.columns * sizeof(VALUE_TYPE)) :
+			((header.rows + 1 + header.nnz) * sizeof(uint64_t) + header.nnz * sizeof(VALUE_TYPE));
+
+		if ((header.payload_size != expected_size) || (available - payload_offset() < header.payload_size))
+		{
+			return NULL;
+		}
+
+		matrix_cache_checksum checksum;
+		checksum.update(source->begin() + payload_offset(), header.payload_size);
+
+		if (checksum.value() != header.checksum)
+		{
+			return NULL;
+		}
+
+		return source.release();
+	}
+
+private:
+	bool enabled_;
+	std::string path_;
+	std::vector<matrix_cache_stamp> stamps_;
+};
+
+#endif /* !MATRIX_CACHE_HPP_ */
@@ -4,9 +4,24 @@
 
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <string.h>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
 
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/matrix_sparse.hpp>
+#include <boost/numeric/ublas/matrix_proxy.hpp>
+
+#include "mapped_file.hpp"
+#include "matrix_cache.hpp"
 
 /* Used only for template parameterization */
 class dump_selector_tag
@@ -161,6 +176,113 @@ std::istream& operator>>(std::istream& source, field_or_record_delimiter_matcher
 	return source;
 }
 
+/* Span of characters making up one (non-blank) record of delimited text */
+struct delimited_record
+{
+	char const* first;
+	char const* last;
+};
+
+/* Helper for skipping insignificant whitespace (including carriage returns from DOS line endings) */
+inline char const* skip_blanks(char const* first, char const* last)
+{
+	while ((first < last) && ((*first == ' ') || (*first == '\t') || (*first == '\r')))
+	{
+		++first;
+	}
+
+	return first;
+}
+
+/* Single scan over a memory range to locate record boundaries (blank records are skipped) */
+template <char RECORD_DELIMITER = '\n'>
+void find_records(char const* first, char const* last, std::vector<delimited_record>& records)
+{
+	while (first < last)
+	{
+		char const* sentinel = static_cast<char const*>(memchr(first, RECORD_DELIMITER, last - first));
+
+		if (sentinel == NULL)
+		{
+			sentinel = last;
+		}
+
+		if (skip_blanks(first, sentinel) < sentinel)
+		{
+			delimited_record record = { first, sentinel };
+			records.push_back(record);
+		}
+
+		first = sentinel + 1;
+	}
+}
+
+/* Locale-free parsing of a single value, returning the position following the value and any trailing blanks (or NULL on failure) */
+template <typename VALUE_TYPE>
+char const* parse_value(char const* first, char const* last, VALUE_TYPE& value)
+{
+	first = skip_blanks(first, last);
+
+	/* std::from_chars rejects an explicit positive sign (which istream extraction accepts) */
+	if ((first < last) && (*first == '+'))
+	{
+		++first;
+	}
+
+	std::from_chars_result result = std::from_chars(first, last, value);
+
+	if (result.ec != std::errc())
+	{
+		return NULL;
+	}
+
+	return skip_blanks(result.ptr, last);
+}
+
+/* Locale-free parsing of a value followed by an expected delimiter, returning the position following the delimiter (or NULL on failure) */
+template <typename VALUE_TYPE>
+char const* parse_delimited_value(char const* first, char const* last, VALUE_TYPE& value, char delimiter)
+{
+	first = parse_value(first, last, value);
+
+	if ((first == NULL) || (first == last) || (*first != delimiter))
+	{
+		return NULL;
+	}
+
+	return first + 1;
+}
+
+/* Locale-free parsing of one record holding an expected number of fields, assigned in turn through an output iterator */
+/* Every field but the last must be followed by a field delimiter, the last by the end of the record (returns false otherwise) */
+template <typename VALUE_TYPE, char FIELD_DELIMITER, class OUTPUT_ITERATOR>
+bool parse_record(char const* first, char const* last, size_t columns, OUTPUT_ITERATOR output)
+{
+	for (size_t j = 0; j < columns; ++j, ++output)
+	{
+		VALUE_TYPE value;
+
+		if (j + 1 < columns)
+		{
+			first = parse_delimited_value(first, last, value, FIELD_DELIMITER);
+		}
+		else
+		{
+			first = parse_value(first, last, value);
+			first = (first == last) ? first : NULL;
+		}
+
+		if (first == NULL)
+		{
+			return false;
+		}
+
+		*output = value;
+	}
+
+	return true;
+}
+
 /* Adapter class to facilitate populating a coordinate matrix for any target matrix type */
 template <typename VALUE_TYPE, class MATRIX_TYPE>
 class coordinate_matrix_adapter
@@ -216,219 +338,475 @@ private:
 	coordinate_matrix_type& external_;
 };
 
-/* This function attempts to populate a matrix with elements given from a chain of CSV inputs as (row, column, value) triplets */
-template <class MATRIX_TYPE, class ... FILENAME_ARGS>
-void load_cartesian_data(MATRIX_TYPE& matrix, FILENAME_ARGS... filenames)
+namespace loading
 {
-	typedef typename MATRIX_TYPE::value_type value_type;
-	typedef typename MATRIX_TYPE::size_type index_type;
+	typedef enum
+	{
+		sequential = 0,
+		chunked_parallel = 1
+	}
+	strategy;
+}
 
-	char const* filename_array[] = { filenames... };
-	char const** filename_ptr = filename_array;
-	char const** filename_sentinel = filename_ptr + sizeof(filename_array) / sizeof(filename_array[0]);
+#if defined(DISABLE_PARALLEL_LOADING)
+#define DEFAULT_LOADING_STRATEGY loading::sequential
+#else
+#define DEFAULT_LOADING_STRATEGY loading::chunked_parallel
+#endif /* DISABLE_PARALLEL_LOADING */
 
-	index_type i = 0;
-	index_type j = 0;
-	value_type value;
+#if !defined(CARTESIAN_CHUNK_MINIMUM_BYTES)
+#define CARTESIAN_CHUNK_MINIMUM_BYTES (1 << 20)
+#endif /* !CARTESIAN_CHUNK_MINIMUM_BYTES */
 
-	/* An adapter allows loading into a coordinate matrix for performance */
-	/* If the target matrix is a coordinate matrix, a specialized adapter avoids a copy */
-	coordinate_matrix_adapter<value_type, MATRIX_TYPE> adapter(matrix);
-	boost::numeric::ublas::coordinate_matrix<value_type>& staging(adapter());
+/* Parsed content of a (row, column, value) triplet input */
+template <typename VALUE_TYPE, typename INDEX_TYPE>
+struct cartesian_triplet
+{
+	INDEX_TYPE i;
+	INDEX_TYPE j;
+	VALUE_TYPE value;
+};
 
-	static delimiter_matcher const& comma = delimiter_matcher(',');
-	static line_discarder const& anything = line_discarder();
+/* Span of triplet records (beginning and ending at record boundaries) parsed independently of any other */
+template <typename VALUE_TYPE, typename INDEX_TYPE>
+class cartesian_chunk
+{
+public:
+	typedef cartesian_triplet<VALUE_TYPE, INDEX_TYPE> triplet_type;
 
-	std::ifstream source(*filename_ptr);
-	if (source.fail())
+public:
+	cartesian_chunk(char const* first, char const* last) :
+		first_(first),
+		last_(last)
 	{
-		throw std::runtime_error("Failed to open source data file");
 	}
 
-	/* This first row is a pair (or triplet) expression row count and column count */
-	source >> i >> comma >> j >> anything;
-	if (!source.good())
+	/* Parse all records in the chunk (any failure is captured for the loading thread to rethrow) */
+	void operator()()
 	{
-		throw std::runtime_error("Failed to parse shape");
+		try
+		{
+			char const* cursor = first_;
+
+			/* Size estimate presumes a short triplet (e.g., "99999,99999,0.123456789\n") to limit reallocation */
+			triplets_.reserve((last_ - first_) / 24);
+
+			while (cursor < last_)
+			{
+				char const* sentinel = static_cast<char const*>(memchr(cursor, '\n', last_ - cursor));
+
+				if (sentinel == NULL)
+				{
+					sentinel = last_;
+				}
+
+				if (skip_blanks(cursor, sentinel) < sentinel)
+				{
+					triplet_type triplet;
+
+					cursor = parse_delimited_value(cursor, sentinel, triplet.i, ',');
+					cursor = (cursor == NULL) ? NULL : parse_delimited_value(cursor, sentinel, triplet.j, ',');
+					cursor = (cursor == NULL) ? NULL : parse_value(cursor, sentinel, triplet.value);
+
+					/* Anything following the value is discarded (consistent with the sequential loader) */
+					if (cursor == NULL)
+					{
+						throw std::runtime_error("Failed to parse cartesian triplet");
+					}
+
+					triplets_.push_back(triplet);
+				}
+
+				cursor = sentinel + 1;
+			}
+		}
+		catch (...)
+		{
+			failure_ = std::current_exception();
+		}
 	}
 
-	/* Assign shape to coordinate matrix */
-	staging.resize(i, j, false);
+	/* Rethrow any failure captured during parsing */
+	void check() const
+	{
+		if (failure_)
+		{
+			std::rethrow_exception(failure_);
+		}
+	}
 
-	/* Loop over input chain */
-	do
+	std::vector<triplet_type> const& triplets() const
 	{
-		/* Read first triplet */
-		source >> i >> comma >> j >> comma >> value >> anything;
-		while (!source.eof())
+		return triplets_;
+	}
+
+private:
+	char const* first_;
+	char const* last_;
+	std::vector<triplet_type> triplets_;
+	std::exception_ptr failure_;
+};
+
+/* Loader populating a matrix from a chain of CSV inputs as (row, column, value) triplets */
+/* By default, each input is split at record boundaries into chunks which are parsed on all cores */
+template <loading::strategy STRATEGY>
+class cartesian_data_loader
+{
+public:
+	template <class MATRIX_TYPE>
+	static void load(MATRIX_TYPE& matrix, char const* const* filename_ptr, char const* const* filename_sentinel)
+	{
+		typedef typename MATRIX_TYPE::value_type value_type;
+		typedef typename MATRIX_TYPE::size_type index_type;
+		typedef cartesian_chunk<value_type, index_type> chunk_type;
+
+		index_type rows = 0;
+		index_type columns = 0;
+
+		/* An adapter allows loading into a coordinate matrix for performance */
+		/* If the target matrix is a coordinate matrix, a specialized adapter avoids a copy */
+		coordinate_matrix_adapter<value_type, MATRIX_TYPE> adapter(matrix);
+		boost::numeric::ublas::coordinate_matrix<value_type>& staging(adapter());
+
+		size_t concurrency = std::max(1u, std::thread::hardware_concurrency());
+
+		/* All inputs remain mapped until the chunks referencing them have been parsed */
+		std::deque<mapped_data_file> sources;
+		std::deque<chunk_type> chunks;
+
+		for (; filename_ptr < filename_sentinel; ++filename_ptr)
 		{
-			if (!source.good())
+			sources.emplace_back(*filename_ptr);
+
+			char const* first = sources.back().begin();
+			char const* last = sources.back().end();
+
+			/* This first row of the first input is a pair (or triplet) expressing row count and column count */
+			if (sources.size() == 1)
 			{
-				throw std::runtime_error("Failed to parse cartesian triplet");
+				char const* sentinel = static_cast<char const*>(memchr(first, '\n', last - first));
+				sentinel = (sentinel == NULL) ? last : sentinel;
+
+				first = parse_delimited_value(first, sentinel, rows, ',');
+				first = (first == NULL) ? NULL : parse_value(first, sentinel, columns);
+
+				if (first == NULL)
+				{
+					throw std::runtime_error("Failed to parse shape");
+				}
+
+				first = std::min(sentinel + 1, last);
 			}
 
-			/* Assign last-read triplet and read next */
-			staging.append_element(i, j, value);
-			source >> i >> comma >> j >> comma >> value >> anything;
+			/* Split at record boundaries, with enough chunks per input to balance load across cores */
+			size_t chunk_size = std::max<size_t>(CARTESIAN_CHUNK_MINIMUM_BYTES, (last - first) / (4 * concurrency) + 1);
+
+			while (first < last)
+			{
+				char const* boundary = first + std::min<size_t>(chunk_size, last - first);
+				char const* sentinel = (boundary < last) ? static_cast<char const*>(memchr(boundary, '\n', last - boundary)) : NULL;
+				boundary = (sentinel == NULL) ? last : (sentinel + 1);
+
+				chunks.emplace_back(first, boundary);
+				first = boundary;
+			}
+		}
+
+		/* Parse all chunks in parallel, with results kept in input order */
+		boost::asio::thread_pool pool(concurrency);
+
+		for (typename std::deque<chunk_type>::iterator iter = chunks.begin(); iter != chunks.end(); ++iter)
+		{
+			boost::asio::post(pool, std::ref(*iter));
 		}
 
-		/* Current source is exhausted */
-		source.close();
+		pool.join();
+
+		size_t count = 0;
+
+		for (typename std::deque<chunk_type>::const_iterator iter = chunks.begin(); iter != chunks.end(); ++iter)
+		{
+			iter->check();
+			count += iter->triplets().size();
+		}
+
+		/* Merge triplets directly into coordinate storage, then sort (summing duplicates) once */
+		staging.resize(rows, columns, false);
+		staging.reserve(count, false);
+
+		size_t filled = 0;
 
-		/* Advance to next available source */
-		if ((++filename_ptr) < filename_sentinel)
+		for (typename std::deque<chunk_type>::const_iterator iter = chunks.begin(); iter != chunks.end(); ++iter)
 		{
-			source.open(*filename_ptr, std::ifstream::in);
-			if (source.fail())
+			for (typename std::vector<typename chunk_type::triplet_type>::const_iterator triplet = iter->triplets().begin(); triplet != iter->triplets().end(); ++triplet, ++filled)
 			{
-				throw std::runtime_error("Failed to open source data file");
+				if ((triplet->i >= rows) || (triplet->j >= columns))
+				{
+					throw std::runtime_error("Cartesian triplet out of range");
+				}
+
+				staging.index1_data()[filled] = triplet->i;
+				staging.index2_data()[filled] = triplet->j;
+				staging.value_data()[filled] = triplet->value;
 			}
 		}
-	}
-	while (source.is_open());
 
-	/* The adapter destructor finalizes population of the target matrix */
-}
+		staging.set_filled(filled);
+		staging.sort();
 
-/* Parser for consuming CSV input data */
-template <typename VALUE_TYPE, class CONSUMER, char FIELD_DELIMITER = ',', char RECORD_DELIMITER = '\n'>
-class dense_data_parser
-{
-public:
-	typedef field_or_record_delimiter_matcher<delimiter_matcher, delimiter_matcher> delimiter_matcher_type;
+		/* The adapter destructor finalizes population of the target matrix */
+	}
+};
 
+/* Specialization for loading each input in turn on the calling thread */
+template <>
+class cartesian_data_loader<loading::sequential>
+{
 public:
-	static void consume(std::istream& source, CONSUMER& consumer)
+	template <class MATRIX_TYPE>
+	static void load(MATRIX_TYPE& matrix, char const* const* filename_ptr, char const* const* filename_sentinel)
 	{
-		delimiter_matcher field_matcher(FIELD_DELIMITER);
-		delimiter_matcher record_matcher(RECORD_DELIMITER);
-		delimiter_matcher_type delimiter_matcher(field_matcher, record_matcher);
-		VALUE_TYPE value;
+		typedef typename MATRIX_TYPE::value_type value_type;
+		typedef typename MATRIX_TYPE::size_type index_type;
+
+		index_type i = 0;
+		index_type j = 0;
+		value_type value;
+
+		/* An adapter allows loading into a coordinate matrix for performance */
+		/* If the target matrix is a coordinate matrix, a specialized adapter avoids a copy */
+		coordinate_matrix_adapter<value_type, MATRIX_TYPE> adapter(matrix);
+		boost::numeric::ublas::coordinate_matrix<value_type>& staging(adapter());
 
-		source.peek();
+		static delimiter_matcher const& comma = delimiter_matcher(',');
+		static line_discarder const& anything = line_discarder();
 
-		while (source.good())
+		std::ifstream source(*filename_ptr);
+		if (source.fail())
 		{
-			source >> value;
-			source >> delimiter_matcher;
+			throw std::runtime_error("Failed to open source data file");
+		}
 
-			switch (delimiter_matcher)
-			{
-			case delimiter_matcher_type::NoMatch:
-				throw std::runtime_error("Failed to parse dense data element");
+		/* This first row is a pair (or triplet) expression row count and column count */
+		source >> i >> comma >> j >> anything;
+		if (!source.good())
+		{
+			throw std::runtime_error("Failed to parse shape");
+		}
 
-			case delimiter_matcher_type::FieldBreak:
-				consumer.consume_value(value);
-				break;
+		/* Assign shape to coordinate matrix */
+		staging.resize(i, j, false);
 
-			case delimiter_matcher_type::RecordBreak:
-				consumer.consume_value(value);
-				consumer.consume_record_break();
-				break;
+		/* Loop over input chain */
+		do
+		{
+			/* Read first triplet */
+			source >> i >> comma >> j >> comma >> value >> anything;
+			while (!source.eof())
+			{
+				if (!source.good())
+				{
+					throw std::runtime_error("Failed to parse cartesian triplet");
+				}
+
+				/* Assign last-read triplet and read next */
+				staging.append_element(i, j, value);
+				source >> i >> comma >> j >> comma >> value >> anything;
 			}
 
-			source.peek();
+			/* Current source is exhausted */
+			source.close();
+
+			/* Advance to next available source */
+			if ((++filename_ptr) < filename_sentinel)
+			{
+				source.open(*filename_ptr, std::ifstream::in);
+				if (source.fail())
+				{
+					throw std::runtime_error("Failed to open source data file");
+				}
+			}
 		}
+		while (source.is_open());
+
+		/* The adapter destructor finalizes population of the target matrix */
 	}
 };
 
-/* CSV consumer for use with dense_data_parser to ascertain matrix shape */
-template <typename VALUE_TYPE>
-class dense_data_shape_consumer
+/* This function attempts to populate a matrix with elements given from a chain of CSV inputs as (row, column, value) triplets */
+template <loading::strategy STRATEGY, class MATRIX_TYPE, class ... FILENAME_ARGS>
+void load_cartesian_data(MATRIX_TYPE& matrix, FILENAME_ARGS... filenames)
 {
-public:
-	dense_data_shape_consumer() :
-		rows(0),
-		columns(0)
-	{
-		;
-	}
+	typedef typename MATRIX_TYPE::value_type value_type;
+
+	char const* filename_array[] = { filenames... };
+	char const* const* filename_sentinel = filename_array + sizeof(filename_array) / sizeof(filename_array[0]);
+
+	/* A fresh binary cache of the inputs is used in preference to parsing them */
+	matrix_cache<value_type> cache(filename_array, filename_sentinel);
 
-	void consume_value(VALUE_TYPE value)
 	{
-		if (rows == 0)
+		coordinate_matrix_adapter<value_type, MATRIX_TYPE> adapter(matrix);
+
+		if (cache.load_sparse(adapter()))
 		{
-			++columns;
+			return;
 		}
 	}
 
-	void consume_record_break()
-	{
-		++rows;
-	}
+	cartesian_data_loader<STRATEGY>::load(matrix, filename_array, filename_sentinel);
+	cache.store_sparse(matrix);
+}
 
-public:
-	uint32_t rows;
-	uint32_t columns;
-};
+/* As above, using the default loading strategy */
+template <class MATRIX_TYPE, class ... FILENAME_ARGS>
+void load_cartesian_data(MATRIX_TYPE& matrix, FILENAME_ARGS... filenames)
+{
+	load_cartesian_data<DEFAULT_LOADING_STRATEGY>(matrix, filenames...);
+}
 
-/* CSV consumer for use with dense_data_parser to populate target matrix */
-template <class MATRIX_TYPE, typename VALUE_TYPE = typename MATRIX_TYPE::value_type>
-class dense_data_load_consumer
+#if !defined(DENSE_DATA_BATCH_VALUES)
+#define DENSE_DATA_BATCH_VALUES (64 * 1024)
+#endif /* !DENSE_DATA_BATCH_VALUES */
+
+/* Parser for consuming CSV input data */
+template <typename VALUE_TYPE, class CONSUMER, char FIELD_DELIMITER = ',', char RECORD_DELIMITER = '\n'>
+class dense_data_parser
 {
 public:
-	typedef typename MATRIX_TYPE::size_type index_type;
+	/* Batched parsing of a memory range (e.g., a mapped file), delivering whole rows to the consumer in contiguous spans */
+	/* The consumer is called as consume_batch(values, rows, columns), with at most DENSE_DATA_BATCH_VALUES values per call (but at least one row) */
+	/* Only one batch is resident at a time, so input of any size can be streamed through the consumer */
+	static void consume_batches(char const* first, char const* last, CONSUMER& consumer)
+	{
+		std::vector<VALUE_TYPE> batch;
+		size_t columns = 0;
+		size_t batch_capacity = 0;
+		size_t batch_rows = 0;
 
+		while (first < last)
+		{
+			char const* sentinel = static_cast<char const*>(memchr(first, RECORD_DELIMITER, last - first));
+
+			if (sentinel == NULL)
+			{
+				sentinel = last;
+			}
+
+			if (skip_blanks(first, sentinel) < sentinel)
+			{
+				/* The first record determines the column count (and so the number of rows per batch) */
+				if (columns == 0)
+				{
+					columns = 1 + std::count(first, sentinel, FIELD_DELIMITER);
+					batch_capacity = std::max<size_t>(1, DENSE_DATA_BATCH_VALUES / columns);
+					batch.resize(batch_capacity * columns);
+				}
+
+				if (!parse_record<VALUE_TYPE, FIELD_DELIMITER>(first, sentinel, columns, &batch[batch_rows * columns]))
+				{
+					throw std::runtime_error("Failed to parse dense data element");
+				}
+
+				if (++batch_rows == batch_capacity)
+				{
+					consumer.consume_batch(&batch[0], batch_rows, columns);
+					batch_rows = 0;
+				}
+			}
+
+			first = sentinel + 1;
+		}
+
+		if (batch_rows > 0)
+		{
+			consumer.consume_batch(&batch[0], batch_rows, columns);
+		}
+	}
+};
+
+/* Batched CSV consumer for use with dense_data_parser to stream rows to a callback without materializing a matrix */
+/* The callback is invoked as callback(row_index, values, columns) for each row in input order */
+template <typename VALUE_TYPE, class CALLBACK>
+class dense_data_row_consumer
+{
 public:
-	dense_data_load_consumer(MATRIX_TYPE& target, index_type rows, index_type columns) :
-		target_(target),
-		i(0),
-		j(0)
+	dense_data_row_consumer(CALLBACK callback) :
+		callback_(callback),
+		rows_(0)
 	{
-		target_.resize(rows, columns, false);
 	}
 
-	void consume_value(VALUE_TYPE value)
+	void consume_batch(VALUE_TYPE const* values, size_t rows, size_t columns)
 	{
-		target_(i, j++) = value;
+		for (size_t i = 0; i < rows; ++i, values += columns)
+		{
+			callback_(rows_++, values, columns);
+		}
 	}
 
-	void consume_record_break()
+	size_t get_row_count() const
 	{
-		++i;
-		j = 0;
+		return rows_;
 	}
 
 private:
-	MATRIX_TYPE& target_;
-	index_type i;
-	index_type j;
+	CALLBACK callback_;
+	size_t rows_;
 };
 
+/* This function streams the rows of a row-major CSV file to a callback (returning the row count) */
+/* The file is memory-mapped and parsed in batches, so only one batch of values is held in memory at a time */
+template <typename VALUE_TYPE, class CALLBACK>
+size_t stream_dense_data(char const* filename, CALLBACK callback)
+{
+	typedef dense_data_row_consumer<VALUE_TYPE, CALLBACK> consumer_type;
+
+	mapped_data_file source(filename);
+	consumer_type consumer(callback);
+
+	dense_data_parser<VALUE_TYPE, consumer_type>::consume_batches(source.begin(), source.end(), consumer);
+	return consumer.get_row_count();
+}
+
 /* This function attempts to populate a matrix from a row-major CSV file */
-template <class MATRIX_TYPE, typename VALUE_TYPE = typename MATRIX_TYPE::value_type>
+/* The file is memory-mapped and scanned once for record boundaries, after which values are parsed directly into the target */
+template <class MATRIX_TYPE, typename VALUE_TYPE = typename MATRIX_TYPE::value_type, char FIELD_DELIMITER = ',', char RECORD_DELIMITER = '\n'>
 void load_dense_data(MATRIX_TYPE& matrix, char const* filename)
 {
-	std::ifstream source(filename);
+	typedef typename MATRIX_TYPE::size_type index_type;
+
+	/* A fresh binary cache of the input is used in preference to parsing it */
+	matrix_cache<VALUE_TYPE> cache(&filename, &filename + 1);
 
-	if (source.fail())
+	if (cache.load_dense(matrix))
 	{
-		throw std::runtime_error("Failed to open source data file");
+		return;
 	}
 
-	/* Prepare to process the file twice (once to size it, once to load it) */
-	std::streampos start = source.tellg();
+	mapped_data_file source(filename);
 
-	/* Determine size of available CSV data */
-	dense_data_shape_consumer<VALUE_TYPE> shape_consumer;
-	dense_data_parser<VALUE_TYPE, dense_data_shape_consumer<VALUE_TYPE>>::consume(source, shape_consumer);
+	/* Determine row count from record boundaries */
+	std::vector<delimited_record> records;
+	find_records<RECORD_DELIMITER>(source.begin(), source.end(), records);
 
-	if (source.fail())
-	{
-		throw std::runtime_error("Failed to analyze source data file");
-	}
+	/* Determine column count from field delimiters in first record */
+	index_type columns = records.empty() ? 0 : 1 + std::count(records.front().first, records.front().last, FIELD_DELIMITER);
 
-	/* Prepare to re-process input */
-	source.seekg(start);
+	matrix.resize(records.size(), columns, false);
 
-	if (source.fail() || source.bad())
+	/* Load CSV data into target matrix */
+	for (index_type i = 0; i < records.size(); ++i)
 	{
-		throw std::runtime_error("Failed to rewind source data file");
+		boost::numeric::ublas::matrix_row<MATRIX_TYPE> row(matrix, i);
+
+		if (!parse_record<VALUE_TYPE, FIELD_DELIMITER>(records[i].first, records[i].last, columns, row.begin()))
+		{
+			throw std::runtime_error("Failed to parse dense data element");
+		}
 	}
 
-	/* Load CSV data into target matrix */
-	dense_data_load_consumer<MATRIX_TYPE, VALUE_TYPE> load_consumer(matrix, shape_consumer.rows, shape_consumer.columns);
-	dense_data_parser<VALUE_TYPE, dense_data_load_consumer<MATRIX_TYPE, VALUE_TYPE>>::consume(source, load_consumer);
+	cache.store_dense(matrix);
 }
 
 #endif /* !MATRIX_IO_HPP_ */
\ No newline at end of file
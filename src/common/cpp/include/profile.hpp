@@ -2,20 +2,93 @@
 #if !defined(PROFILE_HPP_)
 #define PROFILE_HPP_
 
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <boost/chrono.hpp>
 
+#include "sample_statistics.hpp"
+#include "trace.hpp"
+
+/* Capacity of the sample buffer reserved for adaptive sampling (beyond which it grows, between samples) */
+#if !defined(ADAPTIVE_SAMPLE_CAPACITY)
+#define ADAPTIVE_SAMPLE_CAPACITY 4096
+#endif /* !ADAPTIVE_SAMPLE_CAPACITY */
+
+/* Number and duration of trials: warmup trials run first and are discarded, and then at least the given number of trials */
+/* are sampled; sampling continues until at least the minimum time is spent and, if a maximum time is given, until the */
+/* 95% confidence interval of the median is narrower than the target width (relative to the median) or the maximum time */
+/* is spent (times counting sampled trials only) */
+struct sampling_policy
+{
+	sampling_policy(int trial_count = 4) :
+		trials(trial_count),
+		warmup(0),
+		min_seconds(0.0),
+		max_seconds(0.0),
+		ci_width(0.05)
+	{
+	}
+
+	bool adaptive() const
+	{
+		return (min_seconds > 0.0) || (max_seconds > 0.0);
+	}
+
+	int trials;
+	int warmup;
+	double min_seconds;
+	double max_seconds;
+	double ci_width;
+};
+
+/* Collectors may observe each sample as it runs by providing start_sample() and stop_sample(flops), called just outside */
+/* the timed region (see collector/perf_counters.hpp) */
+template <class COLLECTOR, class = void>
+struct observes_samples : std::false_type
+{
+};
+
+template <class COLLECTOR>
+struct observes_samples<COLLECTOR, decltype(std::declval<COLLECTOR&>().start_sample())> : std::true_type
+{
+};
+
+/* Subjects may declare the floating-point operations of each sample by providing a public sample_flops() */
+template <class PROFILEE, class = void>
+struct declares_flops : std::false_type
+{
+};
+
+template <class PROFILEE>
+struct declares_flops<PROFILEE, decltype(static_cast<void>(std::declval<PROFILEE const&>().sample_flops()))> : std::true_type
+{
+};
+
 template <class PROFILEE, class COLLECTOR>
 class profiler : protected PROFILEE
 {
 private:
 	typedef PROFILEE superclass;
 	typedef typename COLLECTOR::time_unit time_unit;
+	typedef boost::chrono::high_resolution_clock clock_type;
 
 public:
-	profiler(int trials, COLLECTOR& collector) :
-		trials_(std::max(1, trials)),
+	profiler(sampling_policy const& policy, COLLECTOR& collector) :
+		policy_(policy),
+		collector_(collector)
+	{
+		initialize();
+	}
+
+	/* Subject-configuring constructor forwards any further arguments to the profiled subject */
+	template <class ... SUBJECT_ARGUMENTS>
+	profiler(sampling_policy const& policy, COLLECTOR& collector, SUBJECT_ARGUMENTS ... subject_arguments) :
+		superclass(subject_arguments ...),
+		policy_(policy),
 		collector_(collector)
 	{
+		initialize();
 	}
 
 public:
@@ -34,57 +107,128 @@ public:
 	}
 
 protected:
+	/* Samples are recorded in a buffer reserved with the profiler, so recording allocates nothing between samples (unless */
+	/* adaptive sampling outgrows the reservation); warmup trials are numbered ahead of sampled trials */
 	void run_trials()
 	{
-		time_unit sample(0);
-		time_unit minimum(0);
-		time_unit maximum(0);
-		time_unit total(0);
+		int trial = 1;
 
-		sample = run_sample(1);
+		for (; trial <= policy_.warmup; ++trial)
+		{
+			run_sample(trial, true);
+		}
 
-		minimum = sample;
-		maximum = sample;
-		total = sample;
+		samples_.clear();
 
-		for (int trial = 2; trial <= trials_; ++trial)
+		clock_type::time_point start = clock_type::now();
+		size_t checkpoint = static_cast<size_t>(policy_.trials);
+
+		do
 		{
-			sample = run_sample(trial);
+			samples_.push_back(run_sample(trial++, false));
+		}
+		while (sample_more(start, checkpoint));
 
-			if (sample < minimum)
-			{
-				minimum = sample;
-			}
+		collector_.register_sample_results(sample_statistics<time_unit>(samples_, policy_.warmup));
+	}
 
-			if (sample > maximum)
-			{
-				maximum = sample;
-			}
+	/* Decides whether to take another sample, checking the confidence interval of the median only at checkpoints spaced */
+	/* geometrically (as its bootstrap is costly) */
+	bool sample_more(clock_type::time_point start, size_t& checkpoint) const
+	{
+		if (samples_.size() < static_cast<size_t>(policy_.trials))
+		{
+			return true;
+		}
 
-			total += sample;
+		double elapsed = boost::chrono::duration<double>(clock_type::now() - start).count();
+
+		if (elapsed < policy_.min_seconds)
+		{
+			return true;
+		}
+
+		if (!(elapsed < policy_.max_seconds))
+		{
+			return false;
 		}
 
-		collector_.register_sample_results(trials_, total, minimum, maximum);
+		if (samples_.size() < checkpoint)
+		{
+			return true;
+		}
+
+		checkpoint = samples_.size() + std::max<size_t>(1, samples_.size() / 2);
+
+		sample_statistics<time_unit> statistics(samples_);
+		return (statistics.median_high() - statistics.median_low()).count() > policy_.ci_width * statistics.median().count();
 	}
 
-	time_unit run_sample(int trial)
+	/* Each trial is traced as a span, enclosing spans of its hooks (with the sample's span just outside its timing), and */
+	/* is passed to the collector once it ends */
+	time_unit run_sample(int trial, bool warmup)
 	{
-		superclass::begin_sample(trial);
+		TRACE_SPAN("trial");
+		time_unit sample(0);
 
-		boost::chrono::high_resolution_clock::time_point t0 = boost::chrono::high_resolution_clock::now();
+		{
+			TRACE_SPAN("begin_sample");
+			superclass::begin_sample(trial);
+		}
 
-		superclass::sample(trial);
+		if constexpr (observes_samples<COLLECTOR>::value)
+		{
+			collector_.start_sample();
+		}
 
-		time_unit sample = boost::chrono::duration_cast<time_unit>(boost::chrono::high_resolution_clock::now() - t0);
+		{
+			TRACE_SPAN("sample");
+			boost::chrono::high_resolution_clock::time_point t0 = boost::chrono::high_resolution_clock::now();
+
+			superclass::sample(trial);
+
+			sample = boost::chrono::duration_cast<time_unit>(boost::chrono::high_resolution_clock::now() - t0);
+		}
 
-		superclass::end_sample(trial);
+		if constexpr (observes_samples<COLLECTOR>::value)
+		{
+			collector_.stop_sample(sample_flops());
+		}
+
+		{
+			TRACE_SPAN("end_sample");
+			superclass::end_sample(trial);
+		}
+
+		collector_.register_trial(trial, sample, warmup);
 		return sample;
 	}
-	
+
+	/* Floating-point operations of a sample, or zero if the subject does not declare them */
+	double sample_flops() const
+	{
+		if constexpr (declares_flops<PROFILEE>::value)
+		{
+			return static_cast<double>(superclass::sample_flops());
+		}
+		else
+		{
+			return 0.0;
+		}
+	}
+
+private:
+	void initialize()
+	{
+		policy_.trials = std::max(1, policy_.trials);
+		policy_.warmup = std::max(0, policy_.warmup);
+		samples_.reserve(policy_.adaptive() ? std::max<size_t>(policy_.trials, ADAPTIVE_SAMPLE_CAPACITY) : policy_.trials);
+	}
 
 private:
-	int trials_;
+	sampling_policy policy_;
 	COLLECTOR& collector_;
+	std::vector<time_unit> samples_;
 };
 
 #endif /* !PROFILE_HPP_ */
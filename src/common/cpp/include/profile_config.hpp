@@ -2,11 +2,18 @@
 #if !defined(PROFILE_CONFIG_HPP_)
 #define PROFILE_CONFIG_HPP_
 
+#include <ctime>
 #include <sstream>
+#include <string>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 #include <boost/filesystem.hpp>
 
+#include "profile.hpp"
+#include "collector/formats.hpp"
+#include "thread_placement.hpp"
+
 /* Helper class for raising exception on bad argument */
 class default_error_handler
 {
@@ -133,6 +140,15 @@ public:
 	profile_config(argument_iterator_type argument_iter, argument_iterator_type argument_end, error_handler_type error_handler = error_handler_type()) :
 		error_handler_(error_handler),
 		trial_count_(4), /* default trial count is 4 */
+		warmup_count_(0), /* no warmup trials by default */
+		min_seconds_(0.0), /* no time budget by default, so exactly the trial count is sampled */
+		max_seconds_(0.0),
+		ci_width_(0.05), /* when sampling to a time budget, stop once the median is known to within 5% */
+		thread_count_(0), /* default thread count (zero) leaves the choice to the parallelization strategy */
+		placement_(placement::unpinned),
+		seed_(static_cast<uint64_t>(std::time(0))), /* default seed varies from run to run (reported so runs can be replayed) */
+		counters_(false), /* hardware counters are only opened on request */
+		format_(output_format::json), /* results are written as a single JSON object per set of samples by default */
 		directory_(argument_end)
 	{
 		char const* argument_name = NULL;
@@ -161,6 +177,38 @@ public:
 				continue;
 			}
 
+			/* Check for "warmup" switch */
+			if (!strcmp(argument, "-w") || !strcmp(argument, "--warmup"))
+			{
+				argument_name = "warmup";
+				consumer = &self_type::consume_warmup_count;
+				continue;
+			}
+
+			/* Check for "min-time" switch */
+			if (!strcmp(argument, "--min-time"))
+			{
+				argument_name = "min-time";
+				consumer = &self_type::consume_min_time;
+				continue;
+			}
+
+			/* Check for "max-time" switch */
+			if (!strcmp(argument, "--max-time"))
+			{
+				argument_name = "max-time";
+				consumer = &self_type::consume_max_time;
+				continue;
+			}
+
+			/* Check for "ci-width" switch */
+			if (!strcmp(argument, "--ci-width"))
+			{
+				argument_name = "ci-width";
+				consumer = &self_type::consume_ci_width;
+				continue;
+			}
+
 			/* Check for "directory" switch */
 			if (!strcmp(argument, "-d") || !strcmp(argument, "--directory"))
 			{
@@ -169,6 +217,69 @@ public:
 				continue;
 			}
 
+			/* Check for "threads" switch */
+			if (!strcmp(argument, "-j") || !strcmp(argument, "--threads"))
+			{
+				argument_name = "threads";
+				consumer = &self_type::consume_thread_count;
+				continue;
+			}
+
+			/* Check for "placement" switch */
+			if (!strcmp(argument, "-p") || !strcmp(argument, "--placement"))
+			{
+				argument_name = "placement";
+				consumer = &self_type::consume_placement;
+				continue;
+			}
+
+			/* Check for "seed" switch */
+			if (!strcmp(argument, "-s") || !strcmp(argument, "--seed"))
+			{
+				argument_name = "seed";
+				consumer = &self_type::consume_seed;
+				continue;
+			}
+
+			/* Check for "counters" switch (which takes no value) */
+			if (!strcmp(argument, "-c") || !strcmp(argument, "--counters"))
+			{
+				counters_ = true;
+				continue;
+			}
+
+			/* Check for "format" switch */
+			if (!strcmp(argument, "-f") || !strcmp(argument, "--format"))
+			{
+				argument_name = "format";
+				consumer = &self_type::consume_format;
+				continue;
+			}
+
+			/* Check for "trace" switch */
+			if (!strcmp(argument, "--trace"))
+			{
+				argument_name = "trace";
+				consumer = &self_type::consume_trace_path;
+				continue;
+			}
+
+			/* Check for "cache" switch */
+			if (!strcmp(argument, "--cache"))
+			{
+				argument_name = "cache";
+				consumer = &self_type::consume_cache_directory;
+				continue;
+			}
+
+			/* Check for "mode" switch */
+			if (!strcmp(argument, "-m") || !strcmp(argument, "--mode"))
+			{
+				argument_name = "mode";
+				consumer = &self_type::consume_mode;
+				continue;
+			}
+
 			argument_name = NULL;
 			error_handler_.bad_argument(argument, "unrecognized option");
 		}
@@ -190,6 +301,66 @@ public:
 		return trial_count_;
 	}
 
+	/* Accessor for sampling policy (trial count, warmup trials, and time budget) */
+	sampling_policy get_sampling_policy() const
+	{
+		sampling_policy policy(trial_count_);
+
+		policy.warmup = warmup_count_;
+		policy.min_seconds = min_seconds_;
+		policy.max_seconds = max_seconds_;
+		policy.ci_width = ci_width_;
+		return policy;
+	}
+
+	/* Accessor for worker thread count (zero if unspecified) */
+	size_t get_thread_count() const
+	{
+		return thread_count_;
+	}
+
+	/* Accessor for worker thread placement policy */
+	placement::policy get_placement() const
+	{
+		return placement_;
+	}
+
+	/* Accessor for random number generator seed */
+	uint64_t get_seed() const
+	{
+		return seed_;
+	}
+
+	/* Accessor for hardware counter collection (whether to count events around each sample) */
+	bool get_counters() const
+	{
+		return counters_;
+	}
+
+	/* Accessor for output format (selecting the collector) */
+	output_format::format get_format() const
+	{
+		return format_;
+	}
+
+	/* Accessor for trace file path (empty if no trace is to be written) */
+	std::string const& get_trace_path() const
+	{
+		return trace_path_;
+	}
+
+	/* Accessor for matrix cache directory (empty if parsed inputs are not to be cached) */
+	std::string const& get_cache_directory() const
+	{
+		return cache_directory_;
+	}
+
+	/* Accessor for benchmark mode name (empty if unspecified, as modes are interpreted by each program) */
+	std::string const& get_mode() const
+	{
+		return mode_;
+	}
+
 private:
 	/* Ingest string argument as integer and assign to this object */
 	void consume_trial_count(char const* name, argument_iterator_type value)
@@ -204,6 +375,129 @@ private:
 		}
 	}
 
+	/* Ingest string argument as (non-negative) integer warmup trial count */
+	void consume_warmup_count(char const* name, argument_iterator_type value)
+	{
+		std::istringstream wrapper(*value);
+
+		wrapper >> warmup_count_;
+
+		if (!wrapper.eof() || wrapper.fail() || (warmup_count_ < 0))
+		{
+			error_handler_.bad_argument(name, "invalid argument value");
+		}
+	}
+
+	/* Ingest string argument as (non-negative) minimum sampling time in seconds */
+	void consume_min_time(char const* name, argument_iterator_type value)
+	{
+		consume_non_negative(name, value, min_seconds_);
+	}
+
+	/* Ingest string argument as (non-negative) maximum sampling time in seconds */
+	void consume_max_time(char const* name, argument_iterator_type value)
+	{
+		consume_non_negative(name, value, max_seconds_);
+	}
+
+	/* Ingest string argument as (positive) target width of the median's confidence interval, relative to the median */
+	void consume_ci_width(char const* name, argument_iterator_type value)
+	{
+		consume_non_negative(name, value, ci_width_);
+
+		if (!(ci_width_ > 0.0))
+		{
+			error_handler_.bad_argument(name, "invalid argument value");
+		}
+	}
+
+	/* Ingest string argument as non-negative real number (e.g., seconds) */
+	void consume_non_negative(char const* name, argument_iterator_type value, double& target)
+	{
+		std::istringstream wrapper(*value);
+
+		wrapper >> target;
+
+		if (!wrapper.eof() || wrapper.fail() || !(target >= 0.0))
+		{
+			error_handler_.bad_argument(name, "invalid argument value");
+		}
+	}
+
+	/* Ingest string argument as (positive) integer thread count */
+	void consume_thread_count(char const* name, argument_iterator_type value)
+	{
+		std::istringstream wrapper(*value);
+		int count = 0;
+
+		wrapper >> count;
+
+		if (!wrapper.eof() || wrapper.fail() || (count <= 0))
+		{
+			error_handler_.bad_argument(name, "invalid argument value");
+		}
+
+		thread_count_ = static_cast<size_t>(count);
+	}
+
+	/* Ingest string argument as placement policy name (none, core, or node) */
+	void consume_placement(char const* name, argument_iterator_type value)
+	{
+		if (!placement::parse(*value, placement_))
+		{
+			error_handler_.bad_argument(name, "invalid argument value (expected none, core, or node)");
+		}
+	}
+
+	/* Ingest string argument as (unsigned 64-bit) seed */
+	void consume_seed(char const* name, argument_iterator_type value)
+	{
+		std::istringstream wrapper(*value);
+
+		wrapper >> seed_;
+
+		if (!wrapper.eof() || wrapper.fail() || (**value == '-'))
+		{
+			error_handler_.bad_argument(name, "invalid argument value");
+		}
+	}
+
+	/* Ingest string argument as benchmark mode name */
+	void consume_mode(char const* name, argument_iterator_type value)
+	{
+		mode_ = *value;
+	}
+
+	/* Ingest string argument as output format name (json, jsonl, csv, or gbench) */
+	void consume_format(char const* name, argument_iterator_type value)
+	{
+		if (!output_format::parse(*value, format_))
+		{
+			error_handler_.bad_argument(name, "invalid argument value (expected json, jsonl, csv, or gbench)");
+		}
+	}
+
+	/* Ingest string argument as trace file path, made absolute so that it is unaffected by the work directory */
+	void consume_trace_path(char const* name, argument_iterator_type value)
+	{
+		trace_path_ = boost::filesystem::absolute(*value).string();
+	}
+
+	/* Ingest string argument as matrix cache directory, made absolute so that it is unaffected by the work directory */
+	/* The directory is created if it doesn't exist */
+	void consume_cache_directory(char const* name, argument_iterator_type value)
+	{
+		boost::system::error_code status;
+
+		cache_directory_ = boost::filesystem::absolute(*value).string();
+		boost::filesystem::create_directories(cache_directory_, status);
+
+		if (!boost::filesystem::is_directory(cache_directory_, status))
+		{
+			error_handler_.bad_argument(name, "failed to create cache directory");
+		}
+	}
+
 	/* Ingest string argument via direct (iterator) assignment */
 	void consume_directory_specifier(char const* name, argument_iterator_type value)
 	{
@@ -252,6 +546,18 @@ private:
 private:
 	error_handler_type error_handler_;
 	int trial_count_;
+	int warmup_count_;
+	double min_seconds_;
+	double max_seconds_;
+	double ci_width_;
+	size_t thread_count_;
+	placement::policy placement_;
+	uint64_t seed_;
+	bool counters_;
+	output_format::format format_;
+	std::string trace_path_;
+	std::string cache_directory_;
+	std::string mode_;
 	argument_iterator_type directory_;
 };
 
@@ -0,0 +1,215 @@
+#pragma once
+#if !defined(SAMPLE_STATISTICS_HPP_)
+#define SAMPLE_STATISTICS_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Resamples drawn for the bootstrap confidence interval of the median */
+#if !defined(BOOTSTRAP_RESAMPLES)
+#define BOOTSTRAP_RESAMPLES 1000
+#endif /* !BOOTSTRAP_RESAMPLES */
+
+/* Summary statistics of a set of sample times (in a boost::chrono duration type), computed once all samples are taken */
+/* Percentiles interpolate linearly between order statistics, the standard deviation is that of a sample (n - 1), and */
+/* the 95% confidence interval of the median is estimated by a percentile bootstrap with a fixed seed (so that identical */
+/* samples always produce an identical interval) */
+/* Samples are copied, so that statistics remain valid after the buffer they were taken from is released or reused */
+template <typename TIME_UNIT>
+class sample_statistics
+{
+public:
+	typedef TIME_UNIT time_unit;
+
+public:
+	sample_statistics(std::vector<time_unit> const& samples, int warmup_count = 0) :
+		samples_(samples),
+		warmup_count_(warmup_count),
+		total_(0),
+		minimum_(0),
+		maximum_(0),
+		mean_(0),
+		median_(0),
+		standard_deviation_(0),
+		p90_(0),
+		p99_(0),
+		median_low_(0),
+		median_high_(0)
+	{
+		if (samples_.empty())
+		{
+			return;
+		}
+
+		std::vector<double> sorted(samples_.size());
+
+		for (size_t i = 0; i < samples_.size(); ++i)
+		{
+			sorted[i] = static_cast<double>(samples_[i].count());
+			total_ += samples_[i];
+		}
+
+		std::sort(sorted.begin(), sorted.end());
+
+		double mean = static_cast<double>(total_.count()) / sorted.size();
+		double squares = 0.0;
+
+		for (size_t i = 0; i < sorted.size(); ++i)
+		{
+			squares += (sorted[i] - mean) * (sorted[i] - mean);
+		}
+
+		minimum_ = to_time(sorted.front());
+		maximum_ = to_time(sorted.back());
+		mean_ = total_ / static_cast<typename time_unit::rep>(sorted.size());
+		median_ = to_time(percentile(sorted, 0.5));
+		standard_deviation_ = to_time((sorted.size() > 1) ? std::sqrt(squares / (sorted.size() - 1)) : 0.0);
+		p90_ = to_time(percentile(sorted, 0.9));
+		p99_ = to_time(percentile(sorted, 0.99));
+
+		bootstrap_median(sorted);
+	}
+
+public:
+	/* Samples in the order taken */
+	std::vector<time_unit> const& samples() const
+	{
+		return samples_;
+	}
+
+	int count() const
+	{
+		return static_cast<int>(samples_.size());
+	}
+
+	/* Trials run (and discarded) before sampling */
+	int warmup_count() const
+	{
+		return warmup_count_;
+	}
+
+	time_unit total() const
+	{
+		return total_;
+	}
+
+	time_unit minimum() const
+	{
+		return minimum_;
+	}
+
+	time_unit maximum() const
+	{
+		return maximum_;
+	}
+
+	time_unit mean() const
+	{
+		return mean_;
+	}
+
+	time_unit median() const
+	{
+		return median_;
+	}
+
+	time_unit standard_deviation() const
+	{
+		return standard_deviation_;
+	}
+
+	time_unit p90() const
+	{
+		return p90_;
+	}
+
+	time_unit p99() const
+	{
+		return p99_;
+	}
+
+	/* Bounds of the 95% confidence interval of the median */
+	time_unit median_low() const
+	{
+		return median_low_;
+	}
+
+	time_unit median_high() const
+	{
+		return median_high_;
+	}
+
+private:
+	static time_unit to_time(double count)
+	{
+		return time_unit(static_cast<typename time_unit::rep>(std::llround(count)));
+	}
+
+	/* Linearly interpolated percentile (fraction in [0, 1]) of sorted values */
+	static double percentile(std::vector<double> const& sorted, double fraction)
+	{
+		double position = fraction * (sorted.size() - 1);
+		size_t lower = static_cast<size_t>(position);
+		size_t upper = std::min(lower + 1, sorted.size() - 1);
+
+		return sorted[lower] + (position - lower) * (sorted[upper] - sorted[lower]);
+	}
+
+	void bootstrap_median(std::vector<double> const& sorted)
+	{
+		std::mt19937_64 generator(0x5eed5eedull);
+		std::uniform_int_distribution<size_t> pick(0, sorted.size() - 1);
+		std::vector<double> resample(sorted.size());
+		std::vector<double> medians(BOOTSTRAP_RESAMPLES);
+
+		for (size_t i = 0; i < medians.size(); ++i)
+		{
+			for (size_t j = 0; j < resample.size(); ++j)
+			{
+				resample[j] = sorted[pick(generator)];
+			}
+
+			medians[i] = median_of(resample);
+		}
+
+		std::sort(medians.begin(), medians.end());
+
+		median_low_ = to_time(percentile(medians, 0.025));
+		median_high_ = to_time(percentile(medians, 0.975));
+	}
+
+	/* Median of unsorted values (which are partially reordered) */
+	static double median_of(std::vector<double>& values)
+	{
+		size_t middle = values.size() / 2;
+
+		std::nth_element(values.begin(), values.begin() + middle, values.end());
+
+		if (values.size() % 2 == 1)
+		{
+			return values[middle];
+		}
+
+		return 0.5 * (values[middle] + *std::max_element(values.begin(), values.begin() + middle));
+	}
+
+private:
+	std::vector<time_unit> samples_;
+	int warmup_count_;
+	time_unit total_;
+	time_unit minimum_;
+	time_unit maximum_;
+	time_unit mean_;
+	time_unit median_;
+	time_unit standard_deviation_;
+	time_unit p90_;
+	time_unit p99_;
+	time_unit median_low_;
+	time_unit median_high_;
+};
+
+#endif /* !SAMPLE_STATISTICS_HPP_ */
@@ -0,0 +1,331 @@
+#pragma once
+#if !defined(THREAD_PLACEMENT_HPP_)
+#define THREAD_PLACEMENT_HPP_
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <string.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif /* __linux__ / _WIN32 */
+
+/* Placement policies for worker threads */
+namespace placement
+{
+	typedef enum
+	{
+		unpinned = 0,
+		core = 1,
+		node = 2
+	}
+	policy;
+
+	/* Parse a policy name as given on the command line (returning false if unrecognized) */
+	inline bool parse(char const* name, policy& result)
+	{
+		static char const* const names[] = { "none", "core", "node" };
+
+		for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+		{
+			if (!strcmp(name, names[i]))
+			{
+				result = static_cast<policy>(i);
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
+
+/* Processors available to this process, grouped by NUMA node */
+/* On Linux, nodes are discovered from sysfs; elsewhere (or on failure) all processors are treated as a single node */
+class cpu_topology
+{
+public:
+	typedef std::vector<int> cpu_set_type;
+
+public:
+	cpu_topology()
+	{
+		cpu_set_type available(available_cpus());
+
+#if defined(__linux__)
+		for (int node = 0; ; ++node)
+		{
+			std::ostringstream path;
+			path << "/sys/devices/system/node/node" << node << "/cpulist";
+
+			std::ifstream source(path.str().c_str());
+			if (source.fail())
+			{
+				break;
+			}
+
+			std::string list;
+			std::getline(source, list);
+
+			cpu_set_type cpus;
+			parse_cpu_list(list, available, cpus);
+
+			if (!cpus.empty())
+			{
+				nodes_.push_back(cpus);
+			}
+		}
+#endif /* __linux__ */
+
+		if (nodes_.empty())
+		{
+			nodes_.push_back(available);
+		}
+	}
+
+	size_t node_count() const
+	{
+		return nodes_.size();
+	}
+
+	cpu_set_type const& node_cpus(size_t node) const
+	{
+		return nodes_[node];
+	}
+
+	/* Processors ordered round-robin over nodes, so that consecutive workers spread evenly across nodes */
+	cpu_set_type interleaved_cpus() const
+	{
+		cpu_set_type interleaved;
+
+		for (size_t i = 0; interleaved.size() < cpu_count(); ++i)
+		{
+			for (size_t node = 0; node < nodes_.size(); ++node)
+			{
+				if (i < nodes_[node].size())
+				{
+					interleaved.push_back(nodes_[node][i]);
+				}
+			}
+		}
+
+		return interleaved;
+	}
+
+	/* Node to which a processor belongs */
+	size_t node_of(int cpu) const
+	{
+		for (size_t node = 0; node < nodes_.size(); ++node)
+		{
+			if (std::find(nodes_[node].begin(), nodes_[node].end(), cpu) != nodes_[node].end())
+			{
+				return node;
+			}
+		}
+
+		return 0;
+	}
+
+	size_t cpu_count() const
+	{
+		size_t count = 0;
+
+		for (size_t node = 0; node < nodes_.size(); ++node)
+		{
+			count += nodes_[node].size();
+		}
+
+		return count;
+	}
+
+private:
+	static cpu_set_type available_cpus()
+	{
+		cpu_set_type cpus;
+
+#if defined(__linux__)
+		cpu_set_t mask;
+		CPU_ZERO(&mask);
+
+		if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+		{
+			for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			{
+				if (CPU_ISSET(cpu, &mask))
+				{
+					cpus.push_back(cpu);
+				}
+			}
+		}
+#endif /* __linux__ */
+
+		if (cpus.empty())
+		{
+			for (int cpu = 0; cpu < static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++cpu)
+			{
+				cpus.push_back(cpu);
+			}
+		}
+
+		return cpus;
+	}
+
+	/* Parse a sysfs CPU list (e.g., "0-3,8-11"), keeping only processors available to this process */
+	static void parse_cpu_list(std::string const& list, cpu_set_type const& available, cpu_set_type& cpus)
+	{
+		std::istringstream source(list);
+		std::string range;
+
+		while (std::getline(source, range, ','))
+		{
+			int first = 0;
+			int last = 0;
+			char dash = 0;
+
+			std::istringstream bounds(range);
+			bounds >> first;
+			last = (bounds >> dash >> last) ? last : first;
+
+			for (int cpu = first; cpu <= last; ++cpu)
+			{
+				if (std::find(available.begin(), available.end(), cpu) != available.end())
+				{
+					cpus.push_back(cpu);
+				}
+			}
+		}
+	}
+
+private:
+	std::vector<cpu_set_type> nodes_;
+};
+
+/* Assignment of workers to processors under a placement policy */
+class thread_placement
+{
+public:
+	thread_placement(placement::policy policy = placement::unpinned) :
+		policy_(policy)
+	{
+	}
+
+	placement::policy get_policy() const
+	{
+		return policy_;
+	}
+
+	cpu_topology const& topology() const
+	{
+		return topology_;
+	}
+
+	/* Number of nodes across which workers (and data replicas) are placed */
+	size_t node_count() const
+	{
+		return (policy_ == placement::unpinned) ? 1 : topology_.node_count();
+	}
+
+	/* Node on which a given worker is placed */
+	size_t worker_node(size_t worker) const
+	{
+		switch (policy_)
+		{
+		case placement::core:
+			{
+				cpu_topology::cpu_set_type cpus(topology_.interleaved_cpus());
+				return topology_.node_of(cpus[worker % cpus.size()]);
+			}
+
+		case placement::node:
+			return worker % topology_.node_count();
+
+		default:
+			return 0;
+		}
+	}
+
+	/* Pins the calling thread as the given worker (per policy), and records its node for current_node() */
+	void pin_worker(size_t worker) const
+	{
+		switch (policy_)
+		{
+		case placement::core:
+			{
+				cpu_topology::cpu_set_type cpus(topology_.interleaved_cpus());
+				pin_current_thread(cpu_topology::cpu_set_type(1, cpus[worker % cpus.size()]));
+			}
+			break;
+
+		case placement::node:
+			pin_current_thread(topology_.node_cpus(worker % topology_.node_count()));
+			break;
+
+		default:
+			break;
+		}
+
+		current_node() = worker_node(worker);
+	}
+
+	/* Pins the calling thread to all processors of a node, and records the node for current_node() */
+	void pin_to_node(size_t node) const
+	{
+		if (policy_ != placement::unpinned)
+		{
+			pin_current_thread(topology_.node_cpus(node));
+		}
+
+		current_node() = node;
+	}
+
+	/* Node of the calling thread, as recorded when pinned (zero for threads never pinned) */
+	static size_t& current_node()
+	{
+		static thread_local size_t node = 0;
+		return node;
+	}
+
+private:
+	/* Best-effort affinity assignment (failure leaves the thread unpinned) */
+	static void pin_current_thread(cpu_topology::cpu_set_type const& cpus)
+	{
+#if defined(__linux__)
+		cpu_set_t mask;
+		CPU_ZERO(&mask);
+
+		for (size_t i = 0; i < cpus.size(); ++i)
+		{
+			CPU_SET(cpus[i], &mask);
+		}
+
+		pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+#elif defined(_WIN32)
+		DWORD_PTR mask = 0;
+
+		for (size_t i = 0; i < cpus.size(); ++i)
+		{
+			if (cpus[i] < static_cast<int>(8 * sizeof(mask)))
+			{
+				mask |= static_cast<DWORD_PTR>(1) << cpus[i];
+			}
+		}
+
+		if (mask != 0)
+		{
+			SetThreadAffinityMask(GetCurrentThread(), mask);
+		}
+#endif /* __linux__ / _WIN32 */
+	}
+
+private:
+	placement::policy policy_;
+	cpu_topology topology_;
+};
+
+#endif /* !THREAD_PLACEMENT_HPP_ */
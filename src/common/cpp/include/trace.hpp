@@ -0,0 +1,324 @@
+#pragma once
+#if !defined(TRACE_HPP_)
+#define TRACE_HPP_
+
+#include <iostream>
+#include <string>
+
+/* Scoped tracing spans, compiled in only when ENABLE_TRACING is defined (otherwise TRACE_SPAN expands to nothing) */
+/* Each thread records completed spans into its own ring buffer (keeping the most recent TRACE_BUFFER_EVENTS), stamped */
+/* with the time stamp counter where available; once the run is over, write_trace exports all threads' spans as a */
+/* Chrome trace-event file (viewable in Perfetto or chrome://tracing) */
+/* Buffers are returned for reuse as their threads exit, so that threads started per call or per epoch share buffers */
+/* (each buffer being one lane of the trace) rather than each allocating its own inside the sample being traced */
+#if defined(ENABLE_TRACING)
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define TRACE_TIME_STAMP_COUNTER
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif /* _MSC_VER */
+#endif /* x86 */
+
+/* Spans retained per thread (older spans are overwritten) */
+#if !defined(TRACE_BUFFER_EVENTS)
+#define TRACE_BUFFER_EVENTS 65536
+#endif /* !TRACE_BUFFER_EVENTS */
+
+namespace tracing
+{
+	/* Time stamp counter ticks, or steady clock nanoseconds if there is no time stamp counter */
+	inline uint64_t timestamp()
+	{
+#if defined(TRACE_TIME_STAMP_COUNTER)
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(boost::chrono::duration_cast<boost::chrono::nanoseconds>(boost::chrono::steady_clock::now().time_since_epoch()).count());
+#endif /* TRACE_TIME_STAMP_COUNTER */
+	}
+
+	/* Completed span (names are string literals, so only their addresses are stored) */
+	struct event
+	{
+		char const* name;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	/* Spans of one thread, written only by that thread and read only once it records no more */
+	class ring_buffer
+	{
+	public:
+		ring_buffer(size_t thread_index) :
+			events_(TRACE_BUFFER_EVENTS),
+			recorded_(0),
+			thread_index_(thread_index)
+		{
+		}
+
+	public:
+		void record(char const* name, uint64_t begin, uint64_t end)
+		{
+			event& slot = events_[recorded_ % events_.size()];
+
+			slot.name = name;
+			slot.begin = begin;
+			slot.end = end;
+			++recorded_;
+		}
+
+		size_t thread_index() const
+		{
+			return thread_index_;
+		}
+
+		/* Spans retained, oldest first */
+		size_t size() const
+		{
+			return std::min<size_t>(recorded_, events_.size());
+		}
+
+		event const& operator[](size_t i) const
+		{
+			return events_[(recorded_ - size() + i) % events_.size()];
+		}
+
+		/* Spans overwritten before export */
+		size_t dropped() const
+		{
+			return static_cast<size_t>(recorded_ - size());
+		}
+
+		bool empty() const
+		{
+			return recorded_ == 0;
+		}
+
+	private:
+		std::vector<event> events_;
+		uint64_t recorded_;
+		size_t thread_index_;
+	};
+
+	/* Buffers of all threads that have recorded a span (kept beyond their threads, for export, and for reuse by later */
+	/* threads); a buffer per hardware thread is allocated when the registry is created, ahead of the first span */
+	class registry
+	{
+	public:
+		static registry& instance()
+		{
+			static registry shared;
+			return shared;
+		}
+
+	public:
+		/* Takes a free buffer for the calling thread (allocating one only if none is free) */
+		ring_buffer* acquire()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			if (free_.empty())
+			{
+				allocate();
+			}
+
+			ring_buffer* buffer = free_.back();
+			free_.pop_back();
+			return buffer;
+		}
+
+		/* Returns the buffer of an exiting thread, keeping its spans */
+		void release(ring_buffer* buffer)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			free_.push_back(buffer);
+		}
+
+		/* Writes a Chrome trace-event file, with timestamps converted to microseconds since the first span, calibrating */
+		/* time stamp counter ticks against the steady clock over the run */
+		void write(std::string const& path)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::ofstream sink(path.c_str());
+
+			if (!sink)
+			{
+				throw std::runtime_error("Failed to open trace file " + path);
+			}
+
+			double elapsed_microseconds = boost::chrono::duration<double, boost::micro>(boost::chrono::steady_clock::now() - origin_time_).count();
+			double ticks_per_microsecond = (elapsed_microseconds > 0.0) ? (timestamp() - origin_ticks_) / elapsed_microseconds : 1.0;
+			size_t events = 0;
+
+			size_t lanes = 0;
+
+			sink << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+
+			for (size_t i = 0; i < buffers_.size(); ++i)
+			{
+				ring_buffer const& buffer = *buffers_[i];
+
+				/* Buffers allocated ahead of need may never have been used */
+				if (buffer.empty())
+				{
+					continue;
+				}
+
+				sink << ((lanes++ > 0) ? "," : "") << "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer.thread_index() <<
+					", \"args\": {\"name\": \"" << ((buffer.thread_index() == 0) ? "main" : "worker") << " " << buffer.thread_index() << "\"}}";
+
+				for (size_t j = 0; j < buffer.size(); ++j)
+				{
+					event const& span = buffer[j];
+
+					sink << ",\n{\"name\": \"" << span.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer.thread_index() <<
+						", \"ts\": " << boost::format("%0.3f") % (static_cast<int64_t>(span.begin - origin_ticks_) / ticks_per_microsecond) <<
+						", \"dur\": " << boost::format("%0.3f") % ((span.end - span.begin) / ticks_per_microsecond) << "}";
+				}
+
+				if (buffer.dropped() > 0)
+				{
+					std::cerr << "[PROGRESS] trace buffer of thread " << buffer.thread_index() << " overflowed (" << buffer.dropped() << " earliest span(s) dropped)" << std::endl;
+				}
+
+				events += buffer.size();
+			}
+
+			sink << "\n]}" << std::endl;
+			std::cerr << "[PROGRESS] wrote " << events << " span(s) from " << lanes << " thread lane(s) to " << path << std::endl;
+		}
+
+	private:
+		registry()
+		{
+			for (size_t i = std::max(1u, std::thread::hardware_concurrency()); i > 0; --i)
+			{
+				allocate();
+			}
+
+			/* Buffers are handed out in order of allocation */
+			std::reverse(free_.begin(), free_.end());
+
+			origin_ticks_ = timestamp();
+			origin_time_ = boost::chrono::steady_clock::now();
+		}
+
+		void allocate()
+		{
+			buffers_.push_back(std::unique_ptr<ring_buffer>(new ring_buffer(buffers_.size())));
+			free_.push_back(buffers_.back().get());
+		}
+
+	private:
+		std::mutex mutex_;
+		std::vector<std::unique_ptr<ring_buffer> > buffers_;
+		std::vector<ring_buffer*> free_;
+		uint64_t origin_ticks_;
+		boost::chrono::steady_clock::time_point origin_time_;
+	};
+
+	/* Hold of a thread on a buffer, from its first span until it exits */
+	class attachment
+	{
+	public:
+		attachment() :
+			buffer_(registry::instance().acquire())
+		{
+		}
+
+		~attachment()
+		{
+			registry::instance().release(buffer_);
+		}
+
+		attachment(attachment const&) = delete;
+		attachment& operator=(attachment const&) = delete;
+
+	public:
+		ring_buffer& buffer()
+		{
+			return *buffer_;
+		}
+
+	private:
+		ring_buffer* buffer_;
+	};
+
+	/* Buffer of the calling thread (acquired on its first span) */
+	inline ring_buffer& local_buffer()
+	{
+		static thread_local attachment local;
+		return local.buffer();
+	}
+
+	/* Records the lifetime of a scope as a span (the buffer is looked up first, so that a thread's first span does not */
+	/* begin before the registry's origin) */
+	class span
+	{
+	public:
+		span(char const* name) :
+			buffer_(local_buffer()),
+			name_(name),
+			begin_(timestamp())
+		{
+		}
+
+		~span()
+		{
+			buffer_.record(name_, begin_, timestamp());
+		}
+
+		span(span const&) = delete;
+		span& operator=(span const&) = delete;
+
+	private:
+		ring_buffer& buffer_;
+		char const* name_;
+		uint64_t begin_;
+	};
+}
+
+#define TRACE_CONCATENATE_(a, b) a##b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_(a, b)
+
+/* Records the remainder of the enclosing scope as a span with the given (string literal) name */
+#define TRACE_SPAN(name) tracing::span TRACE_CONCATENATE(trace_span_, __LINE__)(name)
+
+/* Records a span from an earlier TRACE_TIMESTAMP() to now, e.g., to show time spent queued between threads */
+#define TRACE_TIMESTAMP() tracing::timestamp()
+#define TRACE_SPAN_SINCE(name, begin) tracing::local_buffer().record((name), (begin), tracing::timestamp())
+
+/* Writes the spans recorded so far (with no spans open and no threads still recording) to a Chrome trace-event file */
+inline void write_trace(std::string const& path)
+{
+	tracing::registry::instance().write(path);
+}
+
+#else
+
+#define TRACE_SPAN(name)
+#define TRACE_TIMESTAMP() 0
+#define TRACE_SPAN_SINCE(name, begin)
+
+inline void write_trace(std::string const& path)
+{
+	std::cerr << "[PROGRESS] tracing is not compiled in (configure with -DTRACING=ON), so no trace is written to " << path << std::endl;
+}
+
+#endif /* ENABLE_TRACING */
+
+#endif /* !TRACE_HPP_ */
@@ -0,0 +1,296 @@
+#pragma once
+#if !defined(ALL_PAIRS_HPP_)
+#define ALL_PAIRS_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boost/align/aligned_allocator.hpp>
+
+#include "bit_count.hpp"
+#include "thread_placement.hpp"
+
+/* Bytes of query and database rows compared together (half each), sized so that both tiles stay resident in L2 cache */
+#if !defined(ALL_PAIRS_TILE_BYTES)
+#define ALL_PAIRS_TILE_BYTES (size_t(512) << 10)
+#endif /* !ALL_PAIRS_TILE_BYTES */
+
+/* Equal-length bitvectors (fingerprints) held contiguously, one row per bitvector padded to a whole cache line */
+class bitvector_collection
+{
+public:
+	typedef uint64_t block_type;
+
+	static const size_t ROW_ALIGNMENT = 64;
+
+public:
+	bitvector_collection(size_t count, size_t bits) :
+		count_(count),
+		bits_(bits),
+		row_blocks_(((bits + 8 * ROW_ALIGNMENT - 1) / (8 * ROW_ALIGNMENT)) * (ROW_ALIGNMENT / sizeof(block_type))),
+		blocks_(count * row_blocks_, 0)
+	{
+	}
+
+public:
+	size_t size() const
+	{
+		return count_;
+	}
+
+	size_t bits() const
+	{
+		return bits_;
+	}
+
+	/* Bytes per row, including padding (which is always clear, so may be counted along with the bits proper) */
+	size_t row_bytes() const
+	{
+		return row_blocks_ * sizeof(block_type);
+	}
+
+	block_type const* row(size_t i) const
+	{
+		return &blocks_[i * row_blocks_];
+	}
+
+	block_type* row(size_t i)
+	{
+		return &blocks_[i * row_blocks_];
+	}
+
+	/* Fills every row with blocks from a generator (a callable returning block_type), leaving padding clear */
+	template <class GENERATOR>
+	void generate(GENERATOR& generator)
+	{
+		size_t full_blocks = bits_ / (8 * sizeof(block_type));
+		size_t remainder = bits_ % (8 * sizeof(block_type));
+
+		for (size_t i = 0; i < count_; ++i)
+		{
+			block_type* blocks = row(i);
+
+			for (size_t j = 0; j < full_blocks; ++j)
+			{
+				blocks[j] = generator();
+			}
+
+			if (remainder > 0)
+			{
+				blocks[full_blocks] = generator() & ((block_type(1) << remainder) - 1);
+			}
+		}
+	}
+
+private:
+	size_t count_;
+	size_t bits_;
+	size_t row_blocks_;
+	std::vector<block_type, boost::alignment::aligned_allocator<block_type, ROW_ALIGNMENT> > blocks_;
+};
+
+/* Jaccard (Tanimoto) similarity of every query against every database bitvector, either as the best k matches per */
+/* query or as a full matrix */
+/* Work is tiled so that a tile of queries is compared against one tile of database rows at a time while both are */
+/* resident in L2 cache; query tiles are the unit of parallelism, claimed dynamically by worker threads, so that each */
+/* query's results are owned by one thread and need no synchronization */
+class all_pairs_similarity
+{
+public:
+	/* Database bitvector matched to a query */
+	struct match
+	{
+		size_t database_index;
+		double similarity;
+	};
+
+	/* Match ordering: higher similarity first, with ties broken by lower database index */
+	static bool better(match const& lhs, match const& rhs)
+	{
+		return (lhs.similarity > rhs.similarity) || ((lhs.similarity == rhs.similarity) && (lhs.database_index < rhs.database_index));
+	}
+
+public:
+	all_pairs_similarity(bit_count_kernels const& kernels, size_t threads = 0, thread_placement const& placement = thread_placement()) :
+		kernels_(kernels),
+		threads_((threads > 0) ? threads : std::max(1u, std::thread::hardware_concurrency())),
+		placement_(placement)
+	{
+	}
+
+public:
+	size_t thread_count() const
+	{
+		return threads_;
+	}
+
+	/* Finds the min(k, database size) best matches for each query, stored by query in best-first order */
+	void top_k(bitvector_collection const& queries, bitvector_collection const& database, size_t k, std::vector<match>& matches) const
+	{
+		match sentinel = { std::numeric_limits<size_t>::max(), -1.0 };
+
+		k = std::min(k, database.size());
+		matches.assign(queries.size() * k, sentinel);
+
+		top_k_sink sink(k, matches);
+		run(queries, database, sink);
+	}
+
+	/* Computes every similarity, stored by query (in single precision, to halve the size of the matrix) */
+	void matrix(bitvector_collection const& queries, bitvector_collection const& database, std::vector<float>& similarities) const
+	{
+		similarities.resize(queries.size() * database.size());
+
+		matrix_sink sink(database.size(), similarities);
+		run(queries, database, sink);
+	}
+
+private:
+	/* Keeps a heap of the best k matches for each query, whose root is the worst of them */
+	class top_k_sink
+	{
+	public:
+		top_k_sink(size_t k, std::vector<match>& matches) :
+			k_(k),
+			matches_(matches)
+		{
+		}
+
+		void accept(size_t query, size_t database_index, double similarity)
+		{
+			match* first = &matches_[query * k_];
+			match candidate = { database_index, similarity };
+
+			if (better(candidate, first[0]))
+			{
+				std::pop_heap(first, first + k_, &all_pairs_similarity::better);
+				first[k_ - 1] = candidate;
+				std::push_heap(first, first + k_, &all_pairs_similarity::better);
+			}
+		}
+
+		void finish(size_t query)
+		{
+			if (k_ > 0)
+			{
+				match* first = &matches_[query * k_];
+				std::sort_heap(first, first + k_, &all_pairs_similarity::better);
+			}
+		}
+
+	private:
+		size_t k_;
+		std::vector<match>& matches_;
+	};
+
+	class matrix_sink
+	{
+	public:
+		matrix_sink(size_t columns, std::vector<float>& similarities) :
+			columns_(columns),
+			similarities_(similarities)
+		{
+		}
+
+		void accept(size_t query, size_t database_index, double similarity)
+		{
+			similarities_[query * columns_ + database_index] = static_cast<float>(similarity);
+		}
+
+		void finish(size_t query)
+		{
+		}
+
+	private:
+		size_t columns_;
+		std::vector<float>& similarities_;
+	};
+
+	template <class SINK>
+	void run(bitvector_collection const& queries, bitvector_collection const& database, SINK& sink) const
+	{
+		assert(queries.bits() == database.bits());
+
+		if ((queries.size() == 0) || (database.size() == 0))
+		{
+			return;
+		}
+
+		/* Query tiles are also kept small enough to balance load across threads */
+		size_t tile_rows = std::max<size_t>(1, ALL_PAIRS_TILE_BYTES / 2 / queries.row_bytes());
+		size_t query_tile_rows = std::max<size_t>(1, std::min(tile_rows, (queries.size() + 4 * threads_ - 1) / (4 * threads_)));
+		size_t query_tiles = (queries.size() + query_tile_rows - 1) / query_tile_rows;
+		size_t workers = std::min(threads_, query_tiles);
+		std::atomic<size_t> next_tile(0);
+
+		if (workers == 1)
+		{
+			work(0, queries, database, query_tile_rows, tile_rows, query_tiles, next_tile, sink);
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		threads.reserve(workers);
+
+		for (size_t worker = 0; worker < workers; ++worker)
+		{
+			threads.push_back(std::thread([&, worker]() { work(worker, queries, database, query_tile_rows, tile_rows, query_tiles, next_tile, sink); }));
+		}
+
+		for (size_t worker = 0; worker < workers; ++worker)
+		{
+			threads[worker].join();
+		}
+	}
+
+	/* Worker loop, comparing each claimed tile of queries against successive tiles of the database */
+	template <class SINK>
+	void work(size_t worker, bitvector_collection const& queries, bitvector_collection const& database, size_t query_tile_rows, size_t database_tile_rows, size_t query_tiles, std::atomic<size_t>& next_tile, SINK& sink) const
+	{
+		bit_count_kernel kernel = kernels_.intersection_and_union;
+		size_t row_bytes = queries.row_bytes();
+
+		placement_.pin_worker(worker);
+
+		for (size_t tile = next_tile++; tile < query_tiles; tile = next_tile++)
+		{
+			size_t query_first = tile * query_tile_rows;
+			size_t query_last = std::min(queries.size(), query_first + query_tile_rows);
+
+			for (size_t database_first = 0; database_first < database.size(); database_first += database_tile_rows)
+			{
+				size_t database_last = std::min(database.size(), database_first + database_tile_rows);
+
+				for (size_t query = query_first; query < query_last; ++query)
+				{
+					bitvector_collection::block_type const* query_row = queries.row(query);
+
+					for (size_t database_index = database_first; database_index < database_last; ++database_index)
+					{
+						size_t counts[2];
+						kernel(query_row, database.row(database_index), row_bytes, counts);
+						sink.accept(query, database_index, (counts[1] > 0) ? static_cast<double>(counts[0]) / counts[1] : 1.0);
+					}
+				}
+			}
+
+			for (size_t query = query_first; query < query_last; ++query)
+			{
+				sink.finish(query);
+			}
+		}
+	}
+
+private:
+	bit_count_kernels kernels_;
+	size_t threads_;
+	thread_placement placement_;
+};
+
+#endif /* !ALL_PAIRS_HPP_ */
@@ -0,0 +1,571 @@
+#pragma once
+#if !defined(BIT_COUNT_HPP_)
+#define BIT_COUNT_HPP_
+
+#include <bit>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <boost/align/aligned_allocator.hpp>
+
+#include "cpu_features.hpp"
+
+#if !defined(DISABLE_HARDWARE_BIT_COUNT) && defined(CPU_FEATURES_AVAILABLE) && (defined(__x86_64__) || defined(_M_X64))
+#define HARDWARE_BIT_COUNT_AVAILABLE
+#endif /* !DISABLE_HARDWARE_BIT_COUNT && x86-64 */
+
+/* Fixed-size bitset held in cache-line aligned blocks of its own, so that the kernels below can stream its blocks in place */
+/* Bits beyond the bitset's size are always clear, so whole blocks may be counted */
+template <typename BLOCK>
+class aligned_bitset
+{
+public:
+	typedef BLOCK block_type;
+	typedef size_t size_type;
+
+	static const size_type bits_per_block = 8 * sizeof(BLOCK);
+	static const size_t ALIGNMENT = 64;
+
+public:
+	explicit aligned_bitset(size_type bits = 0) :
+		bits_(bits),
+		blocks_((bits + bits_per_block - 1) / bits_per_block, 0)
+	{
+	}
+
+public:
+	size_type size() const
+	{
+		return bits_;
+	}
+
+	size_type num_blocks() const
+	{
+		return blocks_.size();
+	}
+
+	/* Resizes the bitset, keeping the bits within both sizes (and clearing any others) */
+	void resize(size_type bits)
+	{
+		blocks_.resize((bits + bits_per_block - 1) / bits_per_block, 0);
+		bits_ = bits;
+		clear_excess();
+	}
+
+	aligned_bitset& set(size_type position)
+	{
+		blocks_[position / bits_per_block] |= BLOCK(1) << (position % bits_per_block);
+		return *this;
+	}
+
+	size_type count() const
+	{
+		size_type total = 0;
+
+		for (size_t i = 0; i < blocks_.size(); ++i)
+		{
+			total += std::popcount(blocks_[i]);
+		}
+
+		return total;
+	}
+
+	BLOCK const* blocks() const
+	{
+		return blocks_.empty() ? NULL : &blocks_[0];
+	}
+
+	/* Mutable access (bits beyond the bitset's size must be left clear) */
+	BLOCK* blocks()
+	{
+		return blocks_.empty() ? NULL : &blocks_[0];
+	}
+
+	/* Set operations over bitsets of equal size */
+	aligned_bitset& operator&=(aligned_bitset const& other)
+	{
+		for (size_t i = 0; i < blocks_.size(); ++i)
+		{
+			blocks_[i] &= other.blocks_[i];
+		}
+
+		return *this;
+	}
+
+	aligned_bitset& operator|=(aligned_bitset const& other)
+	{
+		for (size_t i = 0; i < blocks_.size(); ++i)
+		{
+			blocks_[i] |= other.blocks_[i];
+		}
+
+		return *this;
+	}
+
+	aligned_bitset& operator^=(aligned_bitset const& other)
+	{
+		for (size_t i = 0; i < blocks_.size(); ++i)
+		{
+			blocks_[i] ^= other.blocks_[i];
+		}
+
+		return *this;
+	}
+
+private:
+	void clear_excess()
+	{
+		size_type excess_bits = bits_ % bits_per_block;
+
+		if (excess_bits > 0)
+		{
+			blocks_.back() &= (BLOCK(1) << excess_bits) - 1;
+		}
+	}
+
+private:
+	size_type bits_;
+	std::vector<BLOCK, boost::alignment::aligned_allocator<BLOCK, ALIGNMENT> > blocks_;
+};
+
+template <typename BLOCK>
+aligned_bitset<BLOCK> operator&(aligned_bitset<BLOCK> const& x, aligned_bitset<BLOCK> const& y)
+{
+	aligned_bitset<BLOCK> result(x);
+	return result &= y;
+}
+
+template <typename BLOCK>
+aligned_bitset<BLOCK> operator|(aligned_bitset<BLOCK> const& x, aligned_bitset<BLOCK> const& y)
+{
+	aligned_bitset<BLOCK> result(x);
+	return result |= y;
+}
+
+template <typename BLOCK>
+aligned_bitset<BLOCK> operator^(aligned_bitset<BLOCK> const& x, aligned_bitset<BLOCK> const& y)
+{
+	aligned_bitset<BLOCK> result(x);
+	return result ^= y;
+}
+
+/* Operations whose set bits are counted, applied block-by-block to one or two bitsets as they are streamed */
+namespace bit_operation
+{
+	typedef enum
+	{
+		population = 0,				/* bits of the first bitset (the second is ignored) */
+		intersection = 1,			/* x & y */
+		union_of = 2,				/* x | y */
+		symmetric_difference = 3,	/* x ^ y (Hamming distance) */
+		intersection_and_union = 4	/* x & y and x | y, counted together (Jaccard similarity) */
+	}
+	operation;
+
+	template <operation OPERATION>
+	class traits
+	{
+	public:
+		static const size_t outputs = (OPERATION == intersection_and_union) ? 2 : 1;
+		static const bool binary = (OPERATION != population);
+	};
+}
+
+/* Kernels counting the set bits of an operation over block arrays (given as bytes, in any multiple of the block size) */
+/* Counts are stored to counts[0] (and, for intersection_and_union, to counts[1]); y is ignored for population counts */
+typedef void (*bit_count_kernel)(void const* x, void const* y, size_t size, size_t* counts);
+
+/* Portable kernel, one 64-bit word at a time */
+template <bit_operation::operation OPERATION>
+class portable_bit_count
+{
+public:
+	typedef bit_operation::traits<OPERATION> traits;
+
+	static void combine(uint64_t x, uint64_t y, uint64_t* results)
+	{
+		switch (OPERATION)
+		{
+		case bit_operation::population: results[0] = x; break;
+		case bit_operation::intersection: results[0] = x & y; break;
+		case bit_operation::union_of: results[0] = x | y; break;
+		case bit_operation::symmetric_difference: results[0] = x ^ y; break;
+		case bit_operation::intersection_and_union: results[0] = x & y; results[traits::outputs - 1] = x | y; break;
+		}
+	}
+
+	static void run(void const* x, void const* y, size_t size, size_t* counts)
+	{
+		unsigned char const* x_bytes = static_cast<unsigned char const*>(x);
+		unsigned char const* y_bytes = static_cast<unsigned char const*>(traits::binary ? y : x);
+		uint64_t results[traits::outputs];
+
+		for (size_t k = 0; k < traits::outputs; ++k)
+		{
+			counts[k] = 0;
+		}
+
+		for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), x_bytes += sizeof(uint64_t), y_bytes += sizeof(uint64_t))
+		{
+			uint64_t x_word;
+			uint64_t y_word = 0;
+
+			memcpy(&x_word, x_bytes, sizeof(x_word));
+
+			if (traits::binary)
+			{
+				memcpy(&y_word, y_bytes, sizeof(y_word));
+			}
+
+			combine(x_word, y_word, results);
+
+			for (size_t k = 0; k < traits::outputs; ++k)
+			{
+				counts[k] += std::popcount(results[k]);
+			}
+		}
+
+		for (; size > 0; --size)
+		{
+			combine(*x_bytes++, *y_bytes++, results);
+
+			for (size_t k = 0; k < traits::outputs; ++k)
+			{
+				counts[k] += std::popcount(results[k]);
+			}
+		}
+	}
+};
+
+#if defined(HARDWARE_BIT_COUNT_AVAILABLE)
+
+/* Scalar kernel using the popcnt instruction, four words at a time (independent counts hide instruction latency) */
+template <bit_operation::operation OPERATION>
+class popcnt_bit_count
+{
+public:
+	typedef bit_operation::traits<OPERATION> traits;
+
+	CPU_TARGET("popcnt")
+	static void run(void const* x, void const* y, size_t size, size_t* counts)
+	{
+		const size_t STRIDE = 4 * sizeof(uint64_t);
+
+		unsigned char const* x_bytes = static_cast<unsigned char const*>(x);
+		unsigned char const* y_bytes = static_cast<unsigned char const*>(traits::binary ? y : x);
+		uint64_t partial_counts[traits::outputs][4] = {};
+
+		for (; size >= STRIDE; size -= STRIDE, x_bytes += STRIDE, y_bytes += STRIDE)
+		{
+			uint64_t x_words[4];
+			uint64_t y_words[4] = {};
+
+			memcpy(x_words, x_bytes, sizeof(x_words));
+
+			if (traits::binary)
+			{
+				memcpy(y_words, y_bytes, sizeof(y_words));
+			}
+
+			for (size_t i = 0; i < 4; ++i)
+			{
+				uint64_t results[traits::outputs];
+				portable_bit_count<OPERATION>::combine(x_words[i], y_words[i], results);
+
+				for (size_t k = 0; k < traits::outputs; ++k)
+				{
+					partial_counts[k][i] += _mm_popcnt_u64(results[k]);
+				}
+			}
+		}
+
+		portable_bit_count<OPERATION>::run(x_bytes, y_bytes, size, counts);
+
+		for (size_t k = 0; k < traits::outputs; ++k)
+		{
+			counts[k] += static_cast<size_t>(partial_counts[k][0] + partial_counts[k][1] + partial_counts[k][2] + partial_counts[k][3]);
+		}
+	}
+};
+
+/* AVX2 kernel using a Harley-Seal carry-save adder network, so that lookup-based counting runs once per 16 vectors */
+template <bit_operation::operation OPERATION>
+class avx2_bit_count
+{
+public:
+	typedef bit_operation::traits<OPERATION> traits;
+
+	CPU_TARGET("avx2")
+	static void run(void const* x, void const* y, size_t size, size_t* counts)
+	{
+		const size_t VECTOR = sizeof(__m256i);
+
+		unsigned char const* x_bytes = static_cast<unsigned char const*>(x);
+		unsigned char const* y_bytes = static_cast<unsigned char const*>(traits::binary ? y : x);
+		adder_state states[traits::outputs];
+
+		for (size_t k = 0; k < traits::outputs; ++k)
+		{
+			states[k].total = states[k].ones = states[k].twos = states[k].fours = states[k].eights = _mm256_setzero_si256();
+		}
+
+		for (; size >= 16 * VECTOR; size -= 16 * VECTOR, x_bytes += 16 * VECTOR, y_bytes += 16 * VECTOR)
+		{
+			__m256i results[traits::outputs][16];
+
+			for (size_t i = 0; i < 16; ++i)
+			{
+				combine(load(x_bytes + i * VECTOR), traits::binary ? load(y_bytes + i * VECTOR) : _mm256_setzero_si256(), results, i);
+			}
+
+			for (size_t k = 0; k < traits::outputs; ++k)
+			{
+				add(states[k], results[k]);
+			}
+		}
+
+		__m256i totals[traits::outputs];
+
+		for (size_t k = 0; k < traits::outputs; ++k)
+		{
+			/* Weight the residual adder outputs by their place values */
+			totals[k] = _mm256_slli_epi64(states[k].total, 4);
+			totals[k] = _mm256_add_epi64(totals[k], _mm256_slli_epi64(count_lanes(states[k].eights), 3));
+			totals[k] = _mm256_add_epi64(totals[k], _mm256_slli_epi64(count_lanes(states[k].fours), 2));
+			totals[k] = _mm256_add_epi64(totals[k], _mm256_slli_epi64(count_lanes(states[k].twos), 1));
+			totals[k] = _mm256_add_epi64(totals[k], count_lanes(states[k].ones));
+		}
+
+		for (; size >= VECTOR; size -= VECTOR, x_bytes += VECTOR, y_bytes += VECTOR)
+		{
+			__m256i results[traits::outputs][1];
+			combine(load(x_bytes), traits::binary ? load(y_bytes) : _mm256_setzero_si256(), results, 0);
+
+			for (size_t k = 0; k < traits::outputs; ++k)
+			{
+				totals[k] = _mm256_add_epi64(totals[k], count_lanes(results[k][0]));
+			}
+		}
+
+		portable_bit_count<OPERATION>::run(x_bytes, y_bytes, size, counts);
+
+		for (size_t k = 0; k < traits::outputs; ++k)
+		{
+			uint64_t lanes[4];
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), totals[k]);
+			counts[k] += static_cast<size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+		}
+	}
+
+private:
+	/* Carry-save adder network state (bits with place values 1, 2, 4 and 8 pending, and lane counts of 16s) */
+	struct adder_state
+	{
+		__m256i total;
+		__m256i ones;
+		__m256i twos;
+		__m256i fours;
+		__m256i eights;
+	};
+
+	CPU_TARGET("avx2")
+	static __m256i load(unsigned char const* bytes)
+	{
+		return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(bytes));
+	}
+
+	template <size_t COUNT>
+	CPU_TARGET("avx2")
+	static void combine(__m256i x, __m256i y, __m256i (&results)[traits::outputs][COUNT], size_t i)
+	{
+		switch (OPERATION)
+		{
+		case bit_operation::population: results[0][i] = x; break;
+		case bit_operation::intersection: results[0][i] = _mm256_and_si256(x, y); break;
+		case bit_operation::union_of: results[0][i] = _mm256_or_si256(x, y); break;
+		case bit_operation::symmetric_difference: results[0][i] = _mm256_xor_si256(x, y); break;
+		case bit_operation::intersection_and_union: results[0][i] = _mm256_and_si256(x, y); results[traits::outputs - 1][i] = _mm256_or_si256(x, y); break;
+		}
+	}
+
+	/* Bit counts of each 64-bit lane of a vector, by nibble lookup */
+	CPU_TARGET("avx2")
+	static __m256i count_lanes(__m256i v)
+	{
+		const __m256i lookup = _mm256_setr_epi8(
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+		const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+
+		__m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_nibbles));
+		__m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibbles));
+
+		return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+	}
+
+	/* Carry-save adder: sums three bit vectors into (high, low) bit vectors */
+	CPU_TARGET("avx2")
+	static void carry_save_add(__m256i& high, __m256i& low, __m256i a, __m256i b, __m256i c)
+	{
+		__m256i partial = _mm256_xor_si256(a, b);
+
+		high = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(partial, c));
+		low = _mm256_xor_si256(partial, c);
+	}
+
+	/* Adds 16 vectors into the adder network */
+	CPU_TARGET("avx2")
+	static void add(adder_state& state, __m256i const* v)
+	{
+		__m256i twos_a, twos_b, fours_a, fours_b, eights_a, eights_b, sixteens;
+
+		carry_save_add(twos_a, state.ones, state.ones, v[0], v[1]);
+		carry_save_add(twos_b, state.ones, state.ones, v[2], v[3]);
+		carry_save_add(fours_a, state.twos, state.twos, twos_a, twos_b);
+		carry_save_add(twos_a, state.ones, state.ones, v[4], v[5]);
+		carry_save_add(twos_b, state.ones, state.ones, v[6], v[7]);
+		carry_save_add(fours_b, state.twos, state.twos, twos_a, twos_b);
+		carry_save_add(eights_a, state.fours, state.fours, fours_a, fours_b);
+		carry_save_add(twos_a, state.ones, state.ones, v[8], v[9]);
+		carry_save_add(twos_b, state.ones, state.ones, v[10], v[11]);
+		carry_save_add(fours_a, state.twos, state.twos, twos_a, twos_b);
+		carry_save_add(twos_a, state.ones, state.ones, v[12], v[13]);
+		carry_save_add(twos_b, state.ones, state.ones, v[14], v[15]);
+		carry_save_add(fours_b, state.twos, state.twos, twos_a, twos_b);
+		carry_save_add(eights_b, state.fours, state.fours, fours_a, fours_b);
+		carry_save_add(sixteens, state.eights, state.eights, eights_a, eights_b);
+
+		state.total = _mm256_add_epi64(state.total, count_lanes(sixteens));
+	}
+};
+
+/* AVX-512 kernel using the VPOPCNTDQ per-lane count, four vectors at a time (independent sums hide instruction latency) */
+template <bit_operation::operation OPERATION>
+class avx512_bit_count
+{
+public:
+	typedef bit_operation::traits<OPERATION> traits;
+
+	CPU_TARGET("avx512f,avx512vpopcntdq")
+	static void run(void const* x, void const* y, size_t size, size_t* counts)
+	{
+		const size_t VECTOR = sizeof(__m512i);
+
+		unsigned char const* x_bytes = static_cast<unsigned char const*>(x);
+		unsigned char const* y_bytes = static_cast<unsigned char const*>(traits::binary ? y : x);
+		__m512i totals[traits::outputs][4];
+
+		for (size_t k = 0; k < traits::outputs; ++k)
+		{
+			for (size_t i = 0; i < 4; ++i)
+			{
+				totals[k][i] = _mm512_setzero_si512();
+			}
+		}
+
+		for (; size >= 4 * VECTOR; size -= 4 * VECTOR, x_bytes += 4 * VECTOR, y_bytes += 4 * VECTOR)
+		{
+			for (size_t i = 0; i < 4; ++i)
+			{
+				accumulate(x_bytes + i * VECTOR, y_bytes + i * VECTOR, totals, i);
+			}
+		}
+
+		for (; size >= VECTOR; size -= VECTOR, x_bytes += VECTOR, y_bytes += VECTOR)
+		{
+			accumulate(x_bytes, y_bytes, totals, 0);
+		}
+
+		portable_bit_count<OPERATION>::run(x_bytes, y_bytes, size, counts);
+
+		for (size_t k = 0; k < traits::outputs; ++k)
+		{
+			uint64_t lanes[8];
+			_mm512_storeu_si512(lanes, _mm512_add_epi64(_mm512_add_epi64(totals[k][0], totals[k][1]), _mm512_add_epi64(totals[k][2], totals[k][3])));
+
+			for (size_t i = 0; i < 8; ++i)
+			{
+				counts[k] += static_cast<size_t>(lanes[i]);
+			}
+		}
+	}
+
+private:
+	CPU_TARGET("avx512f,avx512vpopcntdq")
+	static void accumulate(unsigned char const* x_bytes, unsigned char const* y_bytes, __m512i (&totals)[traits::outputs][4], size_t i)
+	{
+		__m512i x = _mm512_loadu_si512(x_bytes);
+		__m512i y = traits::binary ? _mm512_loadu_si512(y_bytes) : _mm512_setzero_si512();
+		__m512i results[traits::outputs];
+
+		switch (OPERATION)
+		{
+		case bit_operation::population: results[0] = x; break;
+		case bit_operation::intersection: results[0] = _mm512_and_si512(x, y); break;
+		case bit_operation::union_of: results[0] = _mm512_or_si512(x, y); break;
+		case bit_operation::symmetric_difference: results[0] = _mm512_xor_si512(x, y); break;
+		case bit_operation::intersection_and_union: results[0] = _mm512_and_si512(x, y); results[traits::outputs - 1] = _mm512_or_si512(x, y); break;
+		}
+
+		for (size_t k = 0; k < traits::outputs; ++k)
+		{
+			totals[k][i] = _mm512_add_epi64(totals[k][i], _mm512_popcnt_epi64(results[k]));
+		}
+	}
+};
+
+#endif /* HARDWARE_BIT_COUNT_AVAILABLE */
+
+/* Kernels for every operation, all for one instruction set */
+struct bit_count_kernels
+{
+	char const* name;
+	bit_count_kernel population;
+	bit_count_kernel intersection;
+	bit_count_kernel union_of;
+	bit_count_kernel symmetric_difference;
+	bit_count_kernel intersection_and_union;
+};
+
+template <template <bit_operation::operation> class KERNEL>
+inline bit_count_kernels make_bit_count_kernels(char const* name)
+{
+	bit_count_kernels kernels =
+	{
+		name,
+		&KERNEL<bit_operation::population>::run,
+		&KERNEL<bit_operation::intersection>::run,
+		&KERNEL<bit_operation::union_of>::run,
+		&KERNEL<bit_operation::symmetric_difference>::run,
+		&KERNEL<bit_operation::intersection_and_union>::run
+	};
+
+	return kernels;
+}
+
+/* Selects the fastest kernels supported by the running processor */
+inline bit_count_kernels select_bit_count_kernels()
+{
+#if defined(HARDWARE_BIT_COUNT_AVAILABLE)
+	if (cpu_features::has_avx512vpopcntdq())
+	{
+		return make_bit_count_kernels<avx512_bit_count>("avx512-vpopcntdq");
+	}
+
+	if (cpu_features::has_avx2())
+	{
+		return make_bit_count_kernels<avx2_bit_count>("avx2-harley-seal");
+	}
+
+	if (cpu_features::has_popcnt())
+	{
+		return make_bit_count_kernels<popcnt_bit_count>("popcnt");
+	}
+#endif /* HARDWARE_BIT_COUNT_AVAILABLE */
+
+	return make_bit_count_kernels<portable_bit_count>("portable");
+}
+
+#endif /* !BIT_COUNT_HPP_ */
@@ -0,0 +1,107 @@
+#pragma once
+#if !defined(COUNTER_RANDOM_HPP_)
+#define COUNTER_RANDOM_HPP_
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Counter-based random generation: each element of each stream is the SplitMix64 output function applied to a counter */
+/* under a key derived from the seed and stream, so any range of elements can be computed independently of the others */
+/* Filling in parallel therefore yields exactly the sequence a serial fill would, whatever the number of threads */
+class counter_random
+{
+public:
+	typedef uint64_t result_type;
+
+	/* Golden ratio increment of SplitMix64 */
+	static const uint64_t GAMMA = 0x9e3779b97f4a7c15ull;
+
+	/* Fewest blocks worth handing to each thread */
+	static const size_t MINIMUM_BLOCKS_PER_THREAD = 65536;
+
+public:
+	counter_random(uint64_t seed) :
+		seed_(seed)
+	{
+	}
+
+public:
+	uint64_t seed() const
+	{
+		return seed_;
+	}
+
+	/* Element of a stream at a given counter */
+	uint64_t operator()(uint64_t stream, uint64_t counter) const
+	{
+		return element(key(stream), counter);
+	}
+
+	/* Fills blocks with consecutive elements of a stream (each block taking the low bits of its element), in parallel */
+	template <typename BLOCK>
+	void fill(uint64_t stream, BLOCK* blocks, size_t count, size_t threads = 0) const
+	{
+		uint64_t stream_key = key(stream);
+
+		threads = (threads > 0) ? threads : std::max(1u, std::thread::hardware_concurrency());
+		threads = std::max<size_t>(1, std::min(threads, count / MINIMUM_BLOCKS_PER_THREAD));
+
+		if (threads == 1)
+		{
+			fill_range(stream_key, blocks, 0, count);
+			return;
+		}
+
+		std::vector<std::thread> workers;
+		workers.reserve(threads);
+
+		for (size_t worker = 0; worker < threads; ++worker)
+		{
+			size_t first = count * worker / threads;
+			size_t last = count * (worker + 1) / threads;
+
+			workers.push_back(std::thread([=]() { fill_range(stream_key, blocks, first, last); }));
+		}
+
+		for (size_t worker = 0; worker < threads; ++worker)
+		{
+			workers[worker].join();
+		}
+	}
+
+	/* SplitMix64 output function (a bijective finalizer, also usable as a hash of 64-bit values) */
+	static uint64_t mix(uint64_t z)
+	{
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+private:
+	uint64_t key(uint64_t stream) const
+	{
+		return mix(seed_ ^ mix(stream * GAMMA + GAMMA));
+	}
+
+	static uint64_t element(uint64_t stream_key, uint64_t counter)
+	{
+		return mix(stream_key + (counter + 1) * GAMMA);
+	}
+
+	template <typename BLOCK>
+	static void fill_range(uint64_t stream_key, BLOCK* blocks, size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; ++i)
+		{
+			blocks[i] = static_cast<BLOCK>(element(stream_key, i));
+		}
+	}
+
+private:
+	uint64_t seed_;
+};
+
+#endif /* !COUNTER_RANDOM_HPP_ */
@@ -1,26 +1,82 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <iostream>
 #include <functional>
+#include <numeric>
+#include <string>
+#include <type_traits>
 #include <boost/chrono.hpp>
+#include <boost/format.hpp>
 #include <boost/random/mersenne_twister.hpp>
-#include <boost/dynamic_bitset.hpp>
-#include <boost/iterator/function_input_iterator.hpp>
-#include <boost/iterator/function_output_iterator.hpp>
+#include <boost/random/geometric_distribution.hpp>
 
+#include "all_pairs.hpp"
+#include "bit_count.hpp"
+#include "counter_random.hpp"
+#include "minhash_lsh.hpp"
+#include "roaring_bitmap.hpp"
 #include "profile.hpp"
 #include "profile_config.hpp"
-#include "collector/json.hpp"
+#include "collector/formats.hpp"
+#include "collector/perf_counters.hpp"
 
 using namespace boost;
 
 const size_t BIT_CAPACITY = 100000000;
 
+/* Dimensions of the all-pairs modes (fingerprint queries scored against a fingerprint database) */
+const size_t QUERY_COUNT = 1024;
+const size_t DATABASE_COUNT = 16384;
+const size_t FINGERPRINT_BITS = 2048;
+const size_t TOP_K = 10;
+
+/* Parameters of the lsh mode: signature bands and rows per band, the similarity at or above which neighbours are sought, */
+/* and the greatest fraction of bits flipped in deriving each query from a database fingerprint */
+const size_t LSH_BANDS = 32;
+const size_t LSH_ROWS = 8;
+const double LSH_THRESHOLD = 0.7;
+const double LSH_MAXIMUM_NOISE = 0.4;
+
+/* Bit densities swept by the density mode, comparing dense bitsets with compressed bitmaps */
+const double DENSITIES[] = { 0.0001, 0.001, 0.003, 0.01, 0.03, 0.1, 0.3 };
+
 typedef random::mt19937 prng_type;
 typedef prng_type::result_type block_type;
-typedef dynamic_bitset<block_type> bitvector_type;
+typedef aligned_bitset<block_type> bitvector_type;
 typedef bitvector_type::size_type size_type;
 
+/* Tag selecting the specialized bit counts, which carries the bit count kernels selected for the running processor */
 class specialization_tag
 {
+public:
+	specialization_tag() :
+		kernels_(select_bit_count_kernels())
+	{
+	}
+
+	bit_count_kernels const& kernels() const
+	{
+		return kernels_;
+	}
+
+	char const* name() const
+	{
+		return kernels_.name;
+	}
+
+	/* Counts the set bits of an operation over two bitsets of equal size, streaming both once */
+	size_type count(bit_count_kernel kernel, bitvector_type const& x, bitvector_type const& y) const
+	{
+		assert(x.size() == y.size());
+
+		size_t counts[2] = { 0, 0 };
+		kernel(x.blocks(), y.blocks(), x.num_blocks() * sizeof(block_type), counts);
+		return counts[0];
+	}
+
+private:
+	bit_count_kernels kernels_;
 };
 
 template <typename SPECIALIZATION>
@@ -29,6 +85,33 @@ size_type count_bits(bitvector_type const& bitvector, SPECIALIZATION const& spec
 	return bitvector.count();
 }
 
+/* Set operation counts over two bitsets of equal size (the generic versions materialize the result of each operation) */
+template <typename SPECIALIZATION>
+size_type intersection_count(bitvector_type const& x, bitvector_type const& y, SPECIALIZATION const& specialization)
+{
+	return count_bits(x & y, specialization);
+}
+
+template <typename SPECIALIZATION>
+size_type union_count(bitvector_type const& x, bitvector_type const& y, SPECIALIZATION const& specialization)
+{
+	return count_bits(x | y, specialization);
+}
+
+template <typename SPECIALIZATION>
+size_type hamming_distance(bitvector_type const& x, bitvector_type const& y, SPECIALIZATION const& specialization)
+{
+	return count_bits(x ^ y, specialization);
+}
+
+/* Jaccard (or Tanimoto) similarity, |x & y| / |x | y| (taken to be one for two empty sets) */
+template <typename SPECIALIZATION>
+double jaccard_similarity(bitvector_type const& x, bitvector_type const& y, SPECIALIZATION const& specialization)
+{
+	size_type unified = union_count(x, y, specialization);
+	return (unified > 0) ? static_cast<double>(intersection_count(x, y, specialization)) / unified : 1.0;
+}
+
 #if defined(USE_KERNIGHAN_BIT_COUNT_ALGORITHM)
 
 class bit_counter
@@ -70,72 +153,608 @@ size_type count_bits<specialization_tag>(bitvector_type const& bitvector, specia
 {
 	size_type count = 0;
 	bit_counter counter(&count);
-	to_block_range(bitvector, make_function_output_iterator(counter));
+	std::for_each(bitvector.blocks(), bitvector.blocks() + bitvector.num_blocks(), counter);
 	return count;
 }
 
+#else
+
+template <>
+size_type count_bits<specialization_tag>(bitvector_type const& bitvector, specialization_tag const& specialization)
+{
+	size_t count = 0;
+	specialization.kernels().population(bitvector.blocks(), NULL, bitvector.num_blocks() * sizeof(block_type), &count);
+	return count;
+}
+
+/* Fused set operation counts, which allocate nothing and stream each bitset once */
+template <>
+size_type intersection_count<specialization_tag>(bitvector_type const& x, bitvector_type const& y, specialization_tag const& specialization)
+{
+	return specialization.count(specialization.kernels().intersection, x, y);
+}
+
+template <>
+size_type union_count<specialization_tag>(bitvector_type const& x, bitvector_type const& y, specialization_tag const& specialization)
+{
+	return specialization.count(specialization.kernels().union_of, x, y);
+}
+
+template <>
+size_type hamming_distance<specialization_tag>(bitvector_type const& x, bitvector_type const& y, specialization_tag const& specialization)
+{
+	return specialization.count(specialization.kernels().symmetric_difference, x, y);
+}
+
+template <>
+double jaccard_similarity<specialization_tag>(bitvector_type const& x, bitvector_type const& y, specialization_tag const& specialization)
+{
+	assert(x.size() == y.size());
+
+	size_t counts[2] = { 0, 0 };
+	specialization.kernels().intersection_and_union(x.blocks(), y.blocks(), x.num_blocks() * sizeof(block_type), counts);
+	return (counts[1] > 0) ? static_cast<double>(counts[0]) / counts[1] : 1.0;
+}
+
 #endif /* USE_KERNIGHAN_BIT_COUNT_ALGORITHM */
 
+/* Fills a bitvector from one stream of a counter-based generator, in parallel */
+void generate_bitvector(counter_random const& generator, uint64_t stream, bitvector_type& bitvector, size_t threads)
+{
+	size_type excess_bits = bitvector.size() % bitvector_type::bits_per_block;
+
+	generator.fill(stream, bitvector.blocks(), bitvector.num_blocks(), threads);
+
+	/* Bits beyond the bitvector's size must be clear */
+	if (excess_bits > 0)
+	{
+		bitvector.blocks()[bitvector.num_blocks() - 1] &= (block_type(1) << excess_bits) - 1;
+	}
+}
+
 class profiler_subject
 {
 protected:
-	profiler_subject() :
+	profiler_subject(uint64_t seed, size_t threads = 0) :
 		x_bitvector_(BIT_CAPACITY),
 		y_bitvector_(BIT_CAPACITY),
 		bitcount_(0),
-		prng_(static_cast<block_type>(std::time(0)))
+		generator_(seed),
+		threads_(threads)
 	{
 	}
 
 protected:
 	void setup()
 	{
+#if defined(USE_KERNIGHAN_BIT_COUNT_ALGORITHM)
+		std::cerr << "[PROGRESS] using kernighan bit count" << std::endl;
+#else
+		std::cerr << "[PROGRESS] using " << specialization_.name() << " bit count kernel" << std::endl;
+#endif /* USE_KERNIGHAN_BIT_COUNT_ALGORITHM */
 	}
 
+	/* Each trial's bitvectors come from their own pair of streams, so a trial is reproducible from the seed alone */
 	void begin_sample(int trial)
 	{
-		size_type zero(0);
-
 		std::cerr << "[PROGRESS] starting trial #" << trial << "..." << std::endl;
 
-		from_block_range(make_function_input_iterator(prng_, zero), make_function_input_iterator(prng_, x_bitvector_.num_blocks()), x_bitvector_);
-		from_block_range(make_function_input_iterator(prng_, zero), make_function_input_iterator(prng_, y_bitvector_.num_blocks()), y_bitvector_);
+		generate_bitvector(generator_, 2 * static_cast<uint64_t>(trial), x_bitvector_, threads_);
+		generate_bitvector(generator_, 2 * static_cast<uint64_t>(trial) + 1, y_bitvector_, threads_);
 	}
 
 	void sample(int trial)
 	{
-		dynamic_bitset<block_type> intersection(x_bitvector_);
-		intersection &= y_bitvector_;
-		bitcount_ = count_bits(intersection, specialization_tag());
+		bitcount_ = intersection_count(x_bitvector_, y_bitvector_, specialization_);
 	}
 
 	void end_sample(int trial)
 	{
 		std::cerr << "[PROGRESS] bit count for trial #" << trial << " of " << BIT_CAPACITY << ": " << bitcount_ << std::endl;
+		std::cerr << "[PROGRESS] jaccard similarity for trial #" << trial << ": " << jaccard_similarity(x_bitvector_, y_bitvector_, specialization_) << std::endl;
+	}
+
+	void teardown()
+	{
+	}
+
+private:
+	bitvector_type x_bitvector_;
+	bitvector_type y_bitvector_;
+	size_type bitcount_;
+	counter_random generator_;
+	size_t threads_;
+	specialization_tag specialization_;
+};
+
+/* Result forms of the all-pairs modes */
+namespace all_pairs_mode
+{
+	typedef enum
+	{
+		top_k,		/* best TOP_K matches per query */
+		matrix		/* full query-by-database similarity matrix */
+	}
+	output;
+}
+
+/* All-pairs similarity of random fingerprint collections, generated once and reused across trials */
+class all_pairs_subject
+{
+protected:
+	all_pairs_subject(all_pairs_mode::output output, uint64_t seed, size_t threads = 0, placement::policy policy = placement::unpinned) :
+		output_(output),
+		queries_(QUERY_COUNT, FINGERPRINT_BITS),
+		database_(DATABASE_COUNT, FINGERPRINT_BITS),
+		generator_(seed),
+		engine_(specialization_.kernels(), threads, thread_placement(policy))
+	{
+	}
+
+protected:
+	void setup()
+	{
+		uint64_t counter = 0;
+		std::function<bitvector_collection::block_type()> query_generator([this, &counter]() { return generator_(0, counter++); });
+		std::function<bitvector_collection::block_type()> database_generator([this, &counter]() { return generator_(1, counter++); });
+
+		std::cerr << "[PROGRESS] using " << specialization_.name() << " bit count kernel on " << engine_.thread_count() << " thread(s)" << std::endl;
+		std::cerr << "[PROGRESS] generating " << QUERY_COUNT << " queries and " << DATABASE_COUNT << " database fingerprints of " << FINGERPRINT_BITS << " bits..." << std::endl;
+
+		queries_.generate(query_generator);
+		counter = 0;
+		database_.generate(database_generator);
+	}
+
+	void begin_sample(int trial)
+	{
+		std::cerr << "[PROGRESS] starting trial #" << trial << "..." << std::endl;
+	}
+
+	void sample(int trial)
+	{
+		if (output_ == all_pairs_mode::top_k)
+		{
+			engine_.top_k(queries_, database_, TOP_K, matches_);
+		}
+		else
+		{
+			engine_.matrix(queries_, database_, similarities_);
+		}
+	}
+
+	void end_sample(int trial)
+	{
+		if (output_ == all_pairs_mode::top_k)
+		{
+			std::cerr << "[PROGRESS] best match for query #0 in trial #" << trial << ": database #" << matches_[0].database_index << " (similarity " << matches_[0].similarity << ")" << std::endl;
+		}
+		else
+		{
+			std::cerr << "[PROGRESS] mean similarity in trial #" << trial << ": " << std::accumulate(similarities_.begin(), similarities_.end(), 0.0) / similarities_.size() << std::endl;
+		}
+	}
+
+	void teardown()
+	{
+	}
+
+private:
+	all_pairs_mode::output output_;
+	bitvector_collection queries_;
+	bitvector_collection database_;
+	counter_random generator_;
+	specialization_tag specialization_;
+	all_pairs_similarity engine_;
+	std::vector<all_pairs_similarity::match> matches_;
+	std::vector<float> similarities_;
+};
+
+/* Approximate search for the database fingerprints at least LSH_THRESHOLD similar to each query: queries are sketched */
+/* and looked up in a banded LSH index of database sketches, and candidates are re-scored exactly by the fused kernel */
+/* Queries are noisy copies of database fingerprints (so each has at least one near neighbour, noise permitting), and */
+/* recall and speedup are measured against exhaustive scoring, which (like LSH queries) runs on one thread, and is timed */
+/* after as many warmup passes as the profiler runs warmup trials (which are likewise left out of LSH query time) */
+template <class COLLECTOR>
+class lsh_subject
+{
+public:
+	typedef typename COLLECTOR::time_unit time_unit;
+
+protected:
+	lsh_subject(uint64_t seed, int warmup) :
+		queries_(QUERY_COUNT, FINGERPRINT_BITS),
+		database_(DATABASE_COUNT, FINGERPRINT_BITS),
+		generator_(seed),
+		sketcher_(LSH_BANDS * LSH_ROWS, seed),
+		index_(LSH_BANDS, LSH_ROWS),
+		query_signature_(LSH_BANDS * LSH_ROWS),
+		exact_neighbours_(0),
+		found_neighbours_(0),
+		candidate_count_(0),
+		estimate_error_(0.0),
+		exhaustive_time_(0),
+		lsh_time_(0),
+		warmup_(std::max(0, warmup)),
+		trials_(0)
+	{
+	}
+
+protected:
+	void setup()
+	{
+		bit_count_kernel kernel = specialization_.kernels().intersection_and_union;
+		size_t row_blocks = database_.row_bytes() / sizeof(bitvector_collection::block_type);
+		uint64_t counter = 0;
+		std::function<bitvector_collection::block_type()> database_generator([this, &counter]() { return generator_(1, counter++); });
+
+		std::cerr << "[PROGRESS] using " << specialization_.name() << " bit count kernel" << std::endl;
+		std::cerr << "[PROGRESS] generating " << DATABASE_COUNT << " database fingerprints of " << FINGERPRINT_BITS << " bits and " << QUERY_COUNT << " noisy copies as queries..." << std::endl;
+
+		database_.generate(database_generator);
+
+		for (size_t query = 0; query < QUERY_COUNT; ++query)
+		{
+			bitvector_collection::block_type const* source = database_.row(generator_(2, query) % DATABASE_COUNT);
+			bitvector_collection::block_type* row = queries_.row(query);
+			double noise = LSH_MAXIMUM_NOISE * unit_interval(generator_(3, query));
+
+			std::copy(source, source + row_blocks, row);
+
+			for (size_t bit = 0; bit < FINGERPRINT_BITS; ++bit)
+			{
+				if (unit_interval(generator_(4, query * FINGERPRINT_BITS + bit)) < noise)
+				{
+					row[bit / 64] ^= bitvector_collection::block_type(1) << (bit % 64);
+				}
+			}
+		}
+
+		/* Exhaustive baseline (the last pass is timed) */
+		boost::chrono::high_resolution_clock::time_point t0;
+
+		for (int pass = 0; pass <= warmup_; ++pass)
+		{
+			t0 = boost::chrono::high_resolution_clock::now();
+			exact_neighbours_ = 0;
+
+			for (size_t query = 0; query < QUERY_COUNT; ++query)
+			{
+				for (size_t entry = 0; entry < DATABASE_COUNT; ++entry)
+				{
+					exact_neighbours_ += (similarity(kernel, queries_.row(query), database_.row(entry), row_blocks) >= LSH_THRESHOLD) ? 1 : 0;
+				}
+			}
+
+			exhaustive_time_ = boost::chrono::duration_cast<time_unit>(boost::chrono::high_resolution_clock::now() - t0);
+		}
+
+		std::cerr << "[PROGRESS] exhaustive scoring found " << exact_neighbours_ << " neighbours in " << exhaustive_time_ << std::endl;
+
+		/* Index of database sketches */
+		std::vector<lsh_index::value_type> signatures(DATABASE_COUNT * sketcher_.length());
+
+		t0 = boost::chrono::high_resolution_clock::now();
+
+		for (size_t entry = 0; entry < DATABASE_COUNT; ++entry)
+		{
+			sketcher_.sketch(database_.row(entry), row_blocks, &signatures[entry * sketcher_.length()]);
+		}
+
+		index_.build(&signatures[0], DATABASE_COUNT);
+		std::cerr << "[PROGRESS] sketched and indexed database in " << boost::chrono::duration_cast<time_unit>(boost::chrono::high_resolution_clock::now() - t0) << std::endl;
+	}
+
+	void begin_sample(int trial)
+	{
+		std::cerr << "[PROGRESS] starting trial #" << trial << "..." << std::endl;
+	}
+
+	void sample(int trial)
+	{
+		boost::chrono::high_resolution_clock::time_point t0 = boost::chrono::high_resolution_clock::now();
+		bit_count_kernel kernel = specialization_.kernels().intersection_and_union;
+		size_t row_blocks = database_.row_bytes() / sizeof(bitvector_collection::block_type);
+
+		found_neighbours_ = 0;
+		candidate_count_ = 0;
+		estimate_error_ = 0.0;
+
+		for (size_t query = 0; query < QUERY_COUNT; ++query)
+		{
+			sketcher_.sketch(queries_.row(query), row_blocks, &query_signature_[0]);
+			index_.query(&query_signature_[0], candidates_);
+			candidate_count_ += candidates_.size();
+
+			for (size_t i = 0; i < candidates_.size(); ++i)
+			{
+				double exact = similarity(kernel, queries_.row(query), database_.row(candidates_[i].id), row_blocks);
+
+				found_neighbours_ += (exact >= LSH_THRESHOLD) ? 1 : 0;
+				estimate_error_ += std::abs(candidates_[i].estimate - exact);
+			}
+		}
+
+		/* Warmup trials are left out of the speedup, as the profiler leaves them out of its statistics */
+		if (trial > warmup_)
+		{
+			lsh_time_ += boost::chrono::duration_cast<time_unit>(boost::chrono::high_resolution_clock::now() - t0);
+			++trials_;
+		}
+	}
+
+	void end_sample(int trial)
+	{
+		std::cerr << "[PROGRESS] lsh found " << found_neighbours_ << " of " << exact_neighbours_ << " neighbours among " << candidate_count_ << " candidates in trial #" << trial << std::endl;
 	}
 
 	void teardown()
 	{
+		std::cerr << "[RESULTS] lsh recall:    " << (exact_neighbours_ > 0 ? static_cast<double>(found_neighbours_) / exact_neighbours_ : 1.0) << std::endl;
+		std::cerr << "[RESULTS] candidates:    " << static_cast<double>(candidate_count_) / QUERY_COUNT << " per query (of " << DATABASE_COUNT << ")" << std::endl;
+		std::cerr << "[RESULTS] estimate mean absolute error: " << (candidate_count_ > 0 ? estimate_error_ / candidate_count_ : 0.0) << std::endl;
+		std::cerr << "[RESULTS] speedup:       " << static_cast<double>(exhaustive_time_.count()) * trials_ / lsh_time_.count() << "x over exhaustive scoring" << std::endl;
 	}
 
 private:
+	static double similarity(bit_count_kernel kernel, bitvector_collection::block_type const* x, bitvector_collection::block_type const* y, size_t blocks)
+	{
+		size_t counts[2];
+		kernel(x, y, blocks * sizeof(bitvector_collection::block_type), counts);
+		return (counts[1] > 0) ? static_cast<double>(counts[0]) / counts[1] : 1.0;
+	}
+
+	/* Maps a random 64-bit value to [0, 1) */
+	static double unit_interval(uint64_t value)
+	{
+		return static_cast<double>(value >> 11) / static_cast<double>(uint64_t(1) << 53);
+	}
+
+private:
+	bitvector_collection queries_;
+	bitvector_collection database_;
+	counter_random generator_;
+	minhash_sketcher sketcher_;
+	lsh_index index_;
+	std::vector<lsh_index::value_type> query_signature_;
+	std::vector<lsh_index::candidate> candidates_;
+	size_t exact_neighbours_;
+	size_t found_neighbours_;
+	size_t candidate_count_;
+	double estimate_error_;
+	time_unit exhaustive_time_;
+	time_unit lsh_time_;
+	int warmup_;
+	int trials_;
+	specialization_tag specialization_;
+};
+
+/* Representations compared by the density mode */
+namespace representation
+{
+	typedef enum
+	{
+		dense,		/* aligned_bitset of BIT_CAPACITY bits */
+		compressed	/* roaring_bitmap */
+	}
+	kind;
+
+	inline char const* name(kind representation)
+	{
+		return (representation == dense) ? "dense" : "compressed";
+	}
+}
+
+/* Generates ascending random bit positions below BIT_CAPACITY, each present with the given probability */
+std::vector<roaring_bitmap::value_type> random_positions(prng_type& prng, double density)
+{
+	std::vector<roaring_bitmap::value_type> positions;
+	random::geometric_distribution<size_t> gap(density);
+
+	positions.reserve(static_cast<size_t>(BIT_CAPACITY * density * 1.01));
+
+	for (size_t position = gap(prng); position < BIT_CAPACITY; position += gap(prng) + 1)
+	{
+		positions.push_back(static_cast<roaring_bitmap::value_type>(position));
+	}
+
+	return positions;
+}
+
+/* Intersection count of two random bitvectors of a given density, in one representation (generated once per sweep step, */
+/* from the same seed for both representations, so that they hold identical bits) */
+class density_subject
+{
+protected:
+	density_subject(double density, representation::kind representation, uint64_t seed) :
+		density_(density),
+		representation_(representation),
+		bitcount_(0),
+		prng_(static_cast<block_type>(seed ^ (seed >> 32)))
+	{
+	}
+
+protected:
+	void setup()
+	{
+		std::vector<roaring_bitmap::value_type> x_positions(random_positions(prng_, density_));
+		std::vector<roaring_bitmap::value_type> y_positions(random_positions(prng_, density_));
+
+		if (representation_ == representation::dense)
+		{
+			x_bitvector_.resize(BIT_CAPACITY);
+			y_bitvector_.resize(BIT_CAPACITY);
+
+			for (size_t i = 0; i < x_positions.size(); ++i)
+			{
+				x_bitvector_.set(x_positions[i]);
+			}
+
+			for (size_t i = 0; i < y_positions.size(); ++i)
+			{
+				y_bitvector_.set(y_positions[i]);
+			}
+
+			std::cerr << "[PROGRESS] dense bitsets of density " << density_ << ": " << x_bitvector_.num_blocks() * sizeof(block_type) << " bytes each" << std::endl;
+		}
+		else
+		{
+			x_bitmap_ = roaring_bitmap::from_sorted(x_positions.begin(), x_positions.end());
+			y_bitmap_ = roaring_bitmap::from_sorted(y_positions.begin(), y_positions.end());
+
+			std::cerr << "[PROGRESS] compressed bitmaps of density " << density_ << ": " << x_bitmap_.content_bytes() << " and " << y_bitmap_.content_bytes() << " bytes (" <<
+				x_bitmap_.container_count(roaring_bitmap::array_container) + y_bitmap_.container_count(roaring_bitmap::array_container) << " array, " <<
+				x_bitmap_.container_count(roaring_bitmap::bitmap_container) + y_bitmap_.container_count(roaring_bitmap::bitmap_container) << " bitmap, " <<
+				x_bitmap_.container_count(roaring_bitmap::run_container) + y_bitmap_.container_count(roaring_bitmap::run_container) << " run containers)" << std::endl;
+		}
+	}
+
+	void begin_sample(int trial)
+	{
+	}
+
+	void sample(int trial)
+	{
+		if (representation_ == representation::dense)
+		{
+			bitcount_ = intersection_count(x_bitvector_, y_bitvector_, specialization_);
+		}
+		else
+		{
+			bitcount_ = x_bitmap_.intersection_count(y_bitmap_, specialization_.kernels().intersection);
+		}
+	}
+
+	void end_sample(int trial)
+	{
+		std::cerr << "[PROGRESS] " << representation::name(representation_) << " bit count for trial #" << trial << " at density " << density_ << ": " << bitcount_ << std::endl;
+	}
+
+	void teardown()
+	{
+	}
+
+private:
+	double density_;
+	representation::kind representation_;
 	bitvector_type x_bitvector_;
 	bitvector_type y_bitvector_;
+	roaring_bitmap x_bitmap_;
+	roaring_bitmap y_bitmap_;
 	size_type bitcount_;
 	prng_type prng_;
+	specialization_tag specialization_;
+};
+
+/* Collector forwarding to another collector, retaining the mean sample time for the density sweep summary */
+template <class COLLECTOR>
+class sweep_collector
+{
+public:
+	typedef typename COLLECTOR::time_unit time_unit;
+
+public:
+	sweep_collector(COLLECTOR& output) :
+		output_(output),
+		mean_(0)
+	{
+	}
+
+public:
+	void register_exception(std::exception const& e)
+	{
+		output_.register_exception(e);
+	}
+
+	void register_trial_metric(char const* name, double value)
+	{
+		output_.register_trial_metric(name, value);
+	}
+
+	void register_trial(int trial, time_unit sample, bool warmup)
+	{
+		output_.register_trial(trial, sample, warmup);
+	}
+
+	void register_sample_results(sample_statistics<time_unit> const& statistics)
+	{
+		output_.register_sample_results(statistics);
+		mean_ = statistics.mean();
+	}
+
+	time_unit mean() const
+	{
+		return mean_;
+	}
+
+private:
+	COLLECTOR& output_;
+	time_unit mean_;
 };
 
 int main(int argc, char* argv[])
 {
 	int result = 0;
-	json_output collector;
 	argv_collection arguments(argc - 1, argv + 1);
 	
 	try
 	{
 		profile_config<argv_collection::const_iterator> config(arguments.begin(), arguments.end());
-		profiler<profiler_subject, json_output> metrics(config.get_trial_count(), collector);
-		metrics.run();
+		std::string mode = config.get_mode().empty() ? std::string("pair") : config.get_mode();
+
+		/* Modes: pair (default) counts the intersection of two large bitvectors, top-k and matrix score all pairs, and */
+		/* density sweeps the density of a pair, comparing dense and compressed representations, and lsh searches approximately */
+		if ((mode != "pair") && (mode != "top-k") && (mode != "matrix") && (mode != "density") && (mode != "lsh"))
+		{
+			throw std::invalid_argument("Argument error for mode: invalid argument value (expected pair, top-k, matrix, density, or lsh)");
+		}
+
+		std::cerr << "[PROGRESS] using seed " << config.get_seed() << " (replay with --seed)" << std::endl;
+
+		/* Results are reported by the collector for the chosen format, with the mode naming the benchmark */
+		with_collector(config.get_format(), "similarity/" + mode, [&](auto& collector)
+		{
+			typedef typename std::decay<decltype(collector)>::type collector_type;
+
+			if (mode == "pair")
+			{
+				run_profiler<profiler_subject>(config.get_sampling_policy(), config.get_counters(), collector, config.get_seed(), config.get_thread_count());
+			}
+			else if ((mode == "top-k") || (mode == "matrix"))
+			{
+				all_pairs_mode::output output = (mode == "top-k") ? all_pairs_mode::top_k : all_pairs_mode::matrix;
+				run_profiler<all_pairs_subject>(config.get_sampling_policy(), config.get_counters(), collector, output, config.get_seed(), config.get_thread_count(), config.get_placement());
+			}
+			else if (mode == "density")
+			{
+				/* Dense and compressed results alternate for each density, in ascending order of density, each run named */
+				/* for its density and representation (e.g., "similarity/density/0.01/dense") */
+				for (size_t i = 0; i < sizeof(DENSITIES) / sizeof(DENSITIES[0]); ++i)
+				{
+					std::string benchmark = (format("similarity/density/%g/") % DENSITIES[i]).str();
+					sweep_collector<collector_type> dense_results(collector);
+					sweep_collector<collector_type> compressed_results(collector);
+
+					collector.set_benchmark(benchmark + representation::name(representation::dense));
+					run_profiler<density_subject>(config.get_sampling_policy(), config.get_counters(), dense_results, DENSITIES[i], representation::dense, config.get_seed());
+
+					collector.set_benchmark(benchmark + representation::name(representation::compressed));
+					run_profiler<density_subject>(config.get_sampling_policy(), config.get_counters(), compressed_results, DENSITIES[i], representation::compressed, config.get_seed());
+
+					std::cerr << "[RESULTS] density " << DENSITIES[i] << ": dense mean " << dense_results.mean() << ", compressed mean " << compressed_results.mean() <<
+						" (" << ((compressed_results.mean() < dense_results.mean()) ? "compressed" : "dense") << " faster)" << std::endl;
+				}
+			}
+			else
+			{
+				run_profiler<lsh_subject<collector_type> >(config.get_sampling_policy(), config.get_counters(), collector, config.get_seed(), config.get_sampling_policy().warmup);
+			}
+		});
+
+		if (!config.get_trace_path().empty())
+		{
+			write_trace(config.get_trace_path());
+		}
 	}
 	catch (std::exception const& e)
 	{
@@ -0,0 +1,241 @@
+#pragma once
+#if !defined(MINHASH_LSH_HPP_)
+#define MINHASH_LSH_HPP_
+
+#include <algorithm>
+#include <bit>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "counter_random.hpp"
+
+/* MinHash sketches by one-permutation hashing: each set bit is hashed once, to one of a signature's bins by the high */
+/* half of its hash, and each bin keeps the minimum of the low halves; empty bins are then filled by rotation (taking */
+/* the value of the nearest non-empty bin to their right, offset by distance), so that sketches of sparse sets remain */
+/* comparable bin-for-bin */
+/* The fraction of bins on which two signatures agree estimates the Jaccard similarity of their sets */
+class minhash_sketcher
+{
+public:
+	typedef uint32_t value_type;
+
+	static const value_type EMPTY = 0xffffffffu;
+
+public:
+	minhash_sketcher(size_t length, uint64_t seed) :
+		length_(length),
+		key_(counter_random::mix(seed ^ counter_random::GAMMA))
+	{
+	}
+
+public:
+	/* Values per signature */
+	size_t length() const
+	{
+		return length_;
+	}
+
+	/* Sketches the set bits of an array of blocks (all bins are left EMPTY for an empty set) */
+	void sketch(uint64_t const* blocks, size_t block_count, value_type* signature) const
+	{
+		std::fill(signature, signature + length_, EMPTY);
+
+		for (size_t i = 0; i < block_count; ++i)
+		{
+			for (uint64_t word = blocks[i]; word != 0; word &= word - 1)
+			{
+				uint64_t hash = counter_random::mix(key_ + (64 * i + std::countr_zero(word) + 1) * counter_random::GAMMA);
+				size_t bin = static_cast<size_t>(((hash >> 32) * length_) >> 32);
+				value_type value = std::min(static_cast<value_type>(hash), static_cast<value_type>(EMPTY - 1));
+
+				signature[bin] = std::min(signature[bin], value);
+			}
+		}
+
+		densify(signature);
+	}
+
+	/* Estimated Jaccard similarity of the sets behind two signatures (of a given length) */
+	static double estimate(value_type const* x, value_type const* y, size_t length)
+	{
+		size_t agreements = 0;
+
+		for (size_t i = 0; i < length; ++i)
+		{
+			agreements += (x[i] == y[i]) ? 1 : 0;
+		}
+
+		return static_cast<double>(agreements) / length;
+	}
+
+private:
+	void densify(value_type* signature) const
+	{
+		size_t filled = 0;
+
+		while ((filled < length_) && (signature[filled] == EMPTY))
+		{
+			++filled;
+		}
+
+		if (filled == length_)
+		{
+			return;
+		}
+
+		/* Walk leftwards (circularly) from a non-empty bin, carrying the value of the last non-empty bin passed */
+		value_type carried = signature[filled];
+		value_type distance = 0;
+
+		for (size_t step = 1; step < length_; ++step)
+		{
+			size_t bin = (filled + length_ - step) % length_;
+
+			if (signature[bin] == EMPTY)
+			{
+				++distance;
+				signature[bin] = static_cast<value_type>(counter_random::mix(carried + distance * counter_random::GAMMA));
+			}
+			else
+			{
+				carried = signature[bin];
+				distance = 0;
+			}
+		}
+	}
+
+private:
+	size_t length_;
+	uint64_t key_;
+};
+
+/* Banded locality-sensitive hashing of MinHash signatures: each signature is split into bands of consecutive rows, and */
+/* an indexed item becomes a candidate for a query when their signatures agree on every row of any one band, which for */
+/* sets of Jaccard similarity J happens with probability 1 - (1 - J^rows)^bands */
+/* The index keeps a copy of each signature, so candidates carry an estimated similarity */
+class lsh_index
+{
+public:
+	typedef minhash_sketcher::value_type value_type;
+
+	/* Indexed item found for a query */
+	struct candidate
+	{
+		size_t id;
+		double estimate;
+	};
+
+public:
+	lsh_index(size_t bands, size_t rows) :
+		bands_(bands),
+		rows_(rows),
+		buckets_(bands)
+	{
+	}
+
+public:
+	size_t signature_length() const
+	{
+		return bands_ * rows_;
+	}
+
+	size_t size() const
+	{
+		return ids_.size();
+	}
+
+	/* Indexes a signature (of signature_length() values) under the given id */
+	void insert(size_t id, value_type const* signature)
+	{
+		size_t slot = ids_.size();
+
+		ids_.push_back(id);
+		signatures_.insert(signatures_.end(), signature, signature + signature_length());
+
+		for (size_t band = 0; band < bands_; ++band)
+		{
+			buckets_[band][band_key(signature, band)].push_back(slot);
+		}
+	}
+
+	/* Replaces the index with a contiguous array of signatures, whose ids are their positions */
+	void build(value_type const* signatures, size_t count)
+	{
+		ids_.clear();
+		signatures_.clear();
+		ids_.reserve(count);
+		signatures_.reserve(count * signature_length());
+
+		for (size_t band = 0; band < bands_; ++band)
+		{
+			buckets_[band].clear();
+			buckets_[band].reserve(count);
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			insert(i, signatures + i * signature_length());
+		}
+	}
+
+	/* Finds the distinct items sharing a band with a signature, in order of insertion */
+	void query(value_type const* signature, std::vector<candidate>& candidates) const
+	{
+		std::vector<size_t>& slots = query_slots();
+
+		slots.clear();
+		candidates.clear();
+
+		for (size_t band = 0; band < bands_; ++band)
+		{
+			bucket_map::const_iterator bucket = buckets_[band].find(band_key(signature, band));
+
+			if (bucket != buckets_[band].end())
+			{
+				slots.insert(slots.end(), bucket->second.begin(), bucket->second.end());
+			}
+		}
+
+		std::sort(slots.begin(), slots.end());
+		slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+		for (size_t i = 0; i < slots.size(); ++i)
+		{
+			candidate found = { ids_[slots[i]], minhash_sketcher::estimate(signature, &signatures_[slots[i] * signature_length()], signature_length()) };
+			candidates.push_back(found);
+		}
+	}
+
+private:
+	typedef std::unordered_map<uint64_t, std::vector<size_t> > bucket_map;
+
+	uint64_t band_key(value_type const* signature, size_t band) const
+	{
+		uint64_t key = counter_random::mix(band + 1);
+
+		for (size_t row = band * rows_; row < (band + 1) * rows_; ++row)
+		{
+			key = counter_random::mix(key ^ signature[row]);
+		}
+
+		return key;
+	}
+
+	/* Scratch space for collecting slots, reused across queries by each thread */
+	static std::vector<size_t>& query_slots()
+	{
+		static thread_local std::vector<size_t> slots;
+		return slots;
+	}
+
+private:
+	size_t bands_;
+	size_t rows_;
+	std::vector<size_t> ids_;
+	std::vector<value_type> signatures_;
+	std::vector<bucket_map> buckets_;
+};
+
+#endif /* !MINHASH_LSH_HPP_ */
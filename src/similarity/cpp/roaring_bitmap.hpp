@@ -0,0 +1,376 @@
+#pragma once
+#if !defined(ROARING_BITMAP_HPP_)
+#define ROARING_BITMAP_HPP_
+
+#include <algorithm>
+#include <bit>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bit_count.hpp"
+
+/* Compressed bitmap of 32-bit values in the style of Roaring: values are partitioned by their high 16 bits into chunks, */
+/* each held in whichever container is smallest for its contents, i.e., a sorted array of low 16 bits (sparse chunks), */
+/* a 65,536-bit bitmap (dense chunks), or a list of runs (clustered chunks) */
+/* Counts are computed directly on the compressed form, pairing containers by chunk and dispatching on their kinds */
+class roaring_bitmap
+{
+public:
+	typedef uint32_t value_type;
+
+	static const size_t CHUNK_BITS = 65536;
+	static const size_t BITMAP_WORDS = CHUNK_BITS / 64;
+
+	/* Container kinds */
+	typedef enum
+	{
+		array_container = 0,
+		bitmap_container = 1,
+		run_container = 2
+	}
+	container_kind;
+
+private:
+	/* Run of consecutive low 16 bits, from start to start + length inclusive */
+	struct run
+	{
+		uint16_t start;
+		uint16_t length;
+	};
+
+	/* Chunk of values sharing their high 16 bits */
+	struct container
+	{
+		uint16_t key;
+		container_kind kind;
+		size_t cardinality;
+		std::vector<uint16_t> values;
+		std::vector<uint64_t> words;
+		std::vector<run> runs;
+	};
+
+public:
+	roaring_bitmap() :
+		cardinality_(0)
+	{
+	}
+
+public:
+	/* Builds a bitmap from values in ascending order (duplicates are ignored) */
+	template <class ITERATOR>
+	static roaring_bitmap from_sorted(ITERATOR first, ITERATOR last)
+	{
+		roaring_bitmap bitmap;
+		std::vector<uint16_t> chunk;
+
+		while (first != last)
+		{
+			uint16_t key = static_cast<uint16_t>(static_cast<value_type>(*first) >> 16);
+
+			chunk.clear();
+
+			for (; (first != last) && (static_cast<uint16_t>(static_cast<value_type>(*first) >> 16) == key); ++first)
+			{
+				uint16_t low = static_cast<uint16_t>(*first);
+
+				if (chunk.empty() || (chunk.back() != low))
+				{
+					chunk.push_back(low);
+				}
+			}
+
+			bitmap.append(key, chunk);
+		}
+
+		return bitmap;
+	}
+
+	size_t cardinality() const
+	{
+		return cardinality_;
+	}
+
+	/* Number of containers of a given kind */
+	size_t container_count(container_kind kind) const
+	{
+		size_t count = 0;
+
+		for (size_t i = 0; i < containers_.size(); ++i)
+		{
+			count += (containers_[i].kind == kind) ? 1 : 0;
+		}
+
+		return count;
+	}
+
+	/* Bytes of container contents (excluding bookkeeping) */
+	size_t content_bytes() const
+	{
+		size_t bytes = 0;
+
+		for (size_t i = 0; i < containers_.size(); ++i)
+		{
+			bytes += containers_[i].values.size() * sizeof(uint16_t) + containers_[i].words.size() * sizeof(uint64_t) + containers_[i].runs.size() * sizeof(run);
+		}
+
+		return bytes;
+	}
+
+	/* Counts values present in both bitmaps, using the given intersection kernel for pairs of bitmap containers */
+	size_t intersection_count(roaring_bitmap const& other, bit_count_kernel bitmap_kernel) const
+	{
+		size_t count = 0;
+		size_t i = 0;
+		size_t j = 0;
+
+		while ((i < containers_.size()) && (j < other.containers_.size()))
+		{
+			container const& x = containers_[i];
+			container const& y = other.containers_[j];
+
+			if (x.key < y.key)
+			{
+				++i;
+			}
+			else if (y.key < x.key)
+			{
+				++j;
+			}
+			else
+			{
+				count += intersection_count(x, y, bitmap_kernel);
+				++i;
+				++j;
+			}
+		}
+
+		return count;
+	}
+
+private:
+	/* Adds a chunk's (ascending, distinct) low 16 bits as a container of the smallest kind */
+	void append(uint16_t key, std::vector<uint16_t> const& chunk)
+	{
+		size_t runs = 0;
+
+		for (size_t i = 0; i < chunk.size(); ++i)
+		{
+			runs += ((i == 0) || (chunk[i] != chunk[i - 1] + 1)) ? 1 : 0;
+		}
+
+		size_t array_bytes = chunk.size() * sizeof(uint16_t);
+		size_t run_bytes = runs * sizeof(run);
+		size_t bitmap_bytes = BITMAP_WORDS * sizeof(uint64_t);
+
+		containers_.push_back(container());
+		container& added = containers_.back();
+
+		added.key = key;
+		added.cardinality = chunk.size();
+		cardinality_ += chunk.size();
+
+		if ((run_bytes < array_bytes) && (run_bytes < bitmap_bytes))
+		{
+			added.kind = run_container;
+			added.runs.reserve(runs);
+
+			for (size_t i = 0; i < chunk.size(); ++i)
+			{
+				if ((i == 0) || (chunk[i] != chunk[i - 1] + 1))
+				{
+					run started = { chunk[i], 0 };
+					added.runs.push_back(started);
+				}
+				else
+				{
+					++added.runs.back().length;
+				}
+			}
+		}
+		else if (array_bytes <= bitmap_bytes)
+		{
+			added.kind = array_container;
+			added.values = chunk;
+		}
+		else
+		{
+			added.kind = bitmap_container;
+			added.words.assign(BITMAP_WORDS, 0);
+
+			for (size_t i = 0; i < chunk.size(); ++i)
+			{
+				added.words[chunk[i] / 64] |= uint64_t(1) << (chunk[i] % 64);
+			}
+		}
+	}
+
+	/* Dispatches on a pair of container kinds (each unordered pair is handled by one routine) */
+	static size_t intersection_count(container const& x, container const& y, bit_count_kernel bitmap_kernel)
+	{
+		if (y.kind < x.kind)
+		{
+			return intersection_count(y, x, bitmap_kernel);
+		}
+
+		switch ((x.kind << 2) | y.kind)
+		{
+		case (array_container << 2) | array_container:
+			return count_array_array(x.values, y.values);
+
+		case (array_container << 2) | bitmap_container:
+			return count_array_bitmap(x.values, y.words);
+
+		case (array_container << 2) | run_container:
+			return count_array_runs(x.values, y.runs);
+
+		case (bitmap_container << 2) | bitmap_container:
+			{
+				size_t count = 0;
+				bitmap_kernel(&x.words[0], &y.words[0], BITMAP_WORDS * sizeof(uint64_t), &count);
+				return count;
+			}
+
+		case (bitmap_container << 2) | run_container:
+			return count_bitmap_runs(x.words, y.runs);
+
+		default:
+			return count_runs_runs(x.runs, y.runs);
+		}
+	}
+
+	/* Sorted array intersection, merging arrays of similar size but galloping (by binary search) through a much larger one */
+	static size_t count_array_array(std::vector<uint16_t> const& x, std::vector<uint16_t> const& y)
+	{
+		std::vector<uint16_t> const& smaller = (x.size() <= y.size()) ? x : y;
+		std::vector<uint16_t> const& larger = (x.size() <= y.size()) ? y : x;
+		size_t count = 0;
+
+		if (smaller.size() * 32 < larger.size())
+		{
+			std::vector<uint16_t>::const_iterator position = larger.begin();
+
+			for (size_t i = 0; (i < smaller.size()) && (position != larger.end()); ++i)
+			{
+				position = std::lower_bound(position, larger.end(), smaller[i]);
+				count += ((position != larger.end()) && (*position == smaller[i])) ? 1 : 0;
+			}
+
+			return count;
+		}
+
+		/* Merge without branching on comparisons (whose outcomes are unpredictable for random values) */
+		uint16_t const* x_values = x.data();
+		uint16_t const* y_values = y.data();
+		size_t i = 0;
+		size_t j = 0;
+
+		while ((i < x.size()) && (j < y.size()))
+		{
+			uint16_t x_value = x_values[i];
+			uint16_t y_value = y_values[j];
+
+			count += (x_value == y_value);
+			i += (x_value <= y_value);
+			j += (y_value <= x_value);
+		}
+
+		return count;
+	}
+
+	static size_t count_array_bitmap(std::vector<uint16_t> const& values, std::vector<uint64_t> const& words)
+	{
+		size_t count = 0;
+
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			count += (words[values[i] / 64] >> (values[i] % 64)) & 1;
+		}
+
+		return count;
+	}
+
+	static size_t count_array_runs(std::vector<uint16_t> const& values, std::vector<run> const& runs)
+	{
+		size_t count = 0;
+		size_t j = 0;
+
+		for (size_t i = 0; (i < values.size()) && (j < runs.size()); ++i)
+		{
+			while ((j < runs.size()) && (size_t(runs[j].start) + runs[j].length < values[i]))
+			{
+				++j;
+			}
+
+			count += ((j < runs.size()) && (runs[j].start <= values[i])) ? 1 : 0;
+		}
+
+		return count;
+	}
+
+	static size_t count_bitmap_runs(std::vector<uint64_t> const& words, std::vector<run> const& runs)
+	{
+		size_t count = 0;
+
+		for (size_t i = 0; i < runs.size(); ++i)
+		{
+			size_t first = runs[i].start;
+			size_t last = first + runs[i].length;
+			size_t first_word = first / 64;
+			size_t last_word = last / 64;
+			uint64_t first_mask = ~uint64_t(0) << (first % 64);
+			uint64_t last_mask = ~uint64_t(0) >> (63 - last % 64);
+
+			if (first_word == last_word)
+			{
+				count += std::popcount(words[first_word] & first_mask & last_mask);
+				continue;
+			}
+
+			count += std::popcount(words[first_word] & first_mask);
+
+			for (size_t word = first_word + 1; word < last_word; ++word)
+			{
+				count += std::popcount(words[word]);
+			}
+
+			count += std::popcount(words[last_word] & last_mask);
+		}
+
+		return count;
+	}
+
+	static size_t count_runs_runs(std::vector<run> const& x, std::vector<run> const& y)
+	{
+		size_t count = 0;
+		size_t i = 0;
+		size_t j = 0;
+
+		while ((i < x.size()) && (j < y.size()))
+		{
+			size_t x_last = size_t(x[i].start) + x[i].length;
+			size_t y_last = size_t(y[j].start) + y[j].length;
+			size_t first = std::max<size_t>(x[i].start, y[j].start);
+			size_t last = std::min(x_last, y_last);
+
+			count += (first <= last) ? (last - first + 1) : 0;
+
+			if (x_last < y_last)
+			{
+				++i;
+			}
+			else
+			{
+				++j;
+			}
+		}
+
+		return count;
+	}
+
+private:
+	std::vector<container> containers_;
+	size_t cardinality_;
+};
+
+#endif /* !ROARING_BITMAP_HPP_ */
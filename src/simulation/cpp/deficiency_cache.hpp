@@ -0,0 +1,229 @@
+#pragma once
+#if !defined(DEFICIENCY_CACHE_HPP_)
+#define DEFICIENCY_CACHE_HPP_
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <string.h>
+
+#include <boost/filesystem.hpp>
+
+#include "matrix_cache.hpp"
+
+/* Persistent cache of per-scenario, per-cohort deficiencies from previous simulation runs */
+/* Scenarios and cohorts are identified by hashes of their content (rather than by position), so that a run after inputs */
+/* are edited, extended or reordered reuses every cell whose scenario and cohort were both seen before; all cells are */
+/* invalidated together when the model key (covering inputs shared by every cell, such as survival) changes */
+/* The cache is a single file in the cache directory, and is disabled (neither loaded nor stored) when there is none */
+
+/* Leading portion of a cache file, followed by scenario keys, cohort keys and then scenarios x cohorts deficiencies */
+struct deficiency_cache_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t model_key;
+	uint64_t scenarios;
+	uint64_t cohorts;
+	uint64_t checksum;
+};
+
+static char const DEFICIENCY_CACHE_MAGIC[8] = { 'D', 'E', 'F', 'C', 'A', 'C', 'H', 'E' };
+static const uint32_t DEFICIENCY_CACHE_VERSION = 1;
+
+/* Content key for an array of values (using the matrix cache checksum as hash) */
+template <typename VALUE_TYPE>
+inline uint64_t content_key(VALUE_TYPE const* values, size_t count)
+{
+	matrix_cache_checksum hash;
+	hash.update(values, count * sizeof(VALUE_TYPE));
+	return hash.value();
+}
+
+class deficiency_cache
+{
+public:
+	static const size_t npos = static_cast<size_t>(-1);
+
+public:
+	deficiency_cache(std::string const& directory, char const* filename) :
+		path_(directory.empty() ? std::string() : (boost::filesystem::path(directory) / filename).string()),
+		cohorts_(0)
+	{
+	}
+
+public:
+	bool enabled() const
+	{
+		return !path_.empty();
+	}
+
+	/* Loads cached deficiencies computed under the given model key (returning false, with the cache empty, if none are usable) */
+	bool load(uint64_t model_key)
+	{
+		if (!enabled())
+		{
+			return false;
+		}
+
+		std::ifstream source(path_.c_str(), std::ios::binary);
+		deficiency_cache_header header;
+
+		if (!source.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			(memcmp(header.magic, DEFICIENCY_CACHE_MAGIC, sizeof(header.magic)) != 0) ||
+			(header.version != DEFICIENCY_CACHE_VERSION) ||
+			(header.byte_order != MATRIX_CACHE_BYTE_ORDER) ||
+			(header.model_key != model_key))
+		{
+			return false;
+		}
+
+		/* Sizes are checked against the file before anything is allocated for them */
+		boost::system::error_code status;
+		uint64_t available = boost::filesystem::file_size(path_, status);
+		uint64_t cells = header.scenarios * header.cohorts;
+
+		if ((status != boost::system::errc::success) || (header.cohorts != 0 && cells / header.cohorts != header.scenarios) ||
+			(available != sizeof(header) + (header.scenarios + header.cohorts + cells) * sizeof(uint64_t)))
+		{
+			return false;
+		}
+
+		std::vector<uint64_t> scenario_keys(header.scenarios);
+		std::vector<uint64_t> cohort_keys(header.cohorts);
+		std::vector<double> deficiencies(header.scenarios * header.cohorts);
+
+		matrix_cache_checksum checksum;
+
+		if (!read(source, scenario_keys, checksum) || !read(source, cohort_keys, checksum) || !read(source, deficiencies, checksum) ||
+			(checksum.value() != header.checksum))
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < scenario_keys.size(); ++i)
+		{
+			scenario_index_.insert(std::make_pair(scenario_keys[i], i));
+		}
+
+		for (size_t j = 0; j < cohort_keys.size(); ++j)
+		{
+			cohort_index_.insert(std::make_pair(cohort_keys[j], j));
+		}
+
+		cohorts_ = cohort_keys.size();
+		deficiencies_.swap(deficiencies);
+		return true;
+	}
+
+	/* Replaces the cache file with the given deficiencies (failures are not fatal, and leave any previous cache in place) */
+	void store(uint64_t model_key, std::vector<uint64_t> const& scenario_keys, std::vector<uint64_t> const& cohort_keys, std::vector<double> const& deficiencies) const
+	{
+		if (!enabled())
+		{
+			return;
+		}
+
+		std::string temporary(path_ + ".tmp");
+		deficiency_cache_header header;
+
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, DEFICIENCY_CACHE_MAGIC, sizeof(header.magic));
+		header.version = DEFICIENCY_CACHE_VERSION;
+		header.byte_order = MATRIX_CACHE_BYTE_ORDER;
+		header.model_key = model_key;
+		header.scenarios = scenario_keys.size();
+		header.cohorts = cohort_keys.size();
+
+		matrix_cache_checksum checksum;
+		update(checksum, scenario_keys);
+		update(checksum, cohort_keys);
+		update(checksum, deficiencies);
+		header.checksum = checksum.value();
+
+		std::ofstream sink(temporary.c_str(), std::ios::binary | std::ios::trunc);
+
+		sink.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		write(sink, scenario_keys);
+		write(sink, cohort_keys);
+		write(sink, deficiencies);
+		sink.close();
+
+		boost::system::error_code status;
+
+		if (sink.fail())
+		{
+			boost::filesystem::remove(temporary, status);
+			return;
+		}
+
+		boost::filesystem::rename(temporary, path_, status);
+
+		if (status != boost::system::errc::success)
+		{
+			boost::filesystem::remove(temporary, status);
+		}
+	}
+
+	/* Position of a scenario in the cache by key (or npos if not cached) */
+	size_t find_scenario(uint64_t key) const
+	{
+		std::unordered_map<uint64_t, size_t>::const_iterator found = scenario_index_.find(key);
+		return (found != scenario_index_.end()) ? found->second : npos;
+	}
+
+	/* Position of a cohort in the cache by key (or npos if not cached) */
+	size_t find_cohort(uint64_t key) const
+	{
+		std::unordered_map<uint64_t, size_t>::const_iterator found = cohort_index_.find(key);
+		return (found != cohort_index_.end()) ? found->second : npos;
+	}
+
+	double deficiency(size_t scenario, size_t cohort) const
+	{
+		return deficiencies_[scenario * cohorts_ + cohort];
+	}
+
+private:
+	template <typename ELEMENT_TYPE>
+	static bool read(std::istream& source, std::vector<ELEMENT_TYPE>& elements, matrix_cache_checksum& checksum)
+	{
+		if (!elements.empty() && !source.read(reinterpret_cast<char*>(&elements[0]), elements.size() * sizeof(ELEMENT_TYPE)))
+		{
+			return false;
+		}
+
+		update(checksum, elements);
+		return true;
+	}
+
+	template <typename ELEMENT_TYPE>
+	static void write(std::ostream& sink, std::vector<ELEMENT_TYPE> const& elements)
+	{
+		if (!elements.empty())
+		{
+			sink.write(reinterpret_cast<char const*>(&elements[0]), elements.size() * sizeof(ELEMENT_TYPE));
+		}
+	}
+
+	template <typename ELEMENT_TYPE>
+	static void update(matrix_cache_checksum& checksum, std::vector<ELEMENT_TYPE> const& elements)
+	{
+		if (!elements.empty())
+		{
+			checksum.update(&elements[0], elements.size() * sizeof(ELEMENT_TYPE));
+		}
+	}
+
+private:
+	std::string path_;
+	size_t cohorts_;
+	std::unordered_map<uint64_t, size_t> scenario_index_;
+	std::unordered_map<uint64_t, size_t> cohort_index_;
+	std::vector<double> deficiencies_;
+};
+
+#endif /* !DEFICIENCY_CACHE_HPP_ */
@@ -1,18 +1,26 @@
 
+#include <cmath>
 #include <iostream>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <type_traits>
+#include <utility>
 #include <assert.h>
 
 #include <boost/asio.hpp>
-#include <boost/bind/bind.hpp>
-#include <boost/thread/latch.hpp>
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/matrix_proxy.hpp>
 
 #include "parallelization.hpp"
+#include "projection.hpp"
+#include "deficiency_cache.hpp"
+#include "yield_curves.hpp"
 #include "matrix_io.hpp"
 #include "profile.hpp"
 #include "profile_config.hpp"
-#include "collector/json.hpp"
+#include "collector/formats.hpp"
+#include "collector/perf_counters.hpp"
 
 using namespace std;
 using namespace boost;
@@ -20,6 +28,8 @@ using namespace boost::asio;
 
 #if defined(DISABLE_PARALLELIZATION)
 typedef parallelization<parallelism::single_threaded> parallelization_type;
+#elif defined(USE_WORK_STEALING)
+typedef parallelization<parallelism::work_stealing> parallelization_type;
 #else
 typedef parallelization<parallelism::multi_threaded> parallelization_type;
 #endif /* DISABLE_PARALLELIZATION */
@@ -28,123 +38,357 @@ typedef parallelization<parallelism::multi_threaded> parallelization_type;
 const size_t POLICY_COUNT = 10000;
 const size_t TIMESTEP_COUNT = 12 * 120;
 
-/* Shorthand for real vector type */
-typedef vector<double> real_vector_type;
+/* Revision of the projection model, included in deficiency cache keys (increment when projection arithmetic changes) */
+const uint64_t PROJECTION_MODEL_REVISION = 2;
+
+/* Deficiency cache file (in the cache directory given by --cache), used when built for incremental simulation */
+char const* const DEFICIENCY_CACHE_FILENAME = "reserves.dcache";
+
+/* Precision of the model: inputs, deficiencies and reserves are SIMULATION_VALUE_TYPE, as is all projection arithmetic */
+/* (double by default; the float32 target projects in single precision) */
+#if !defined(SIMULATION_VALUE_TYPE)
+#define SIMULATION_VALUE_TYPE double
+#endif /* !SIMULATION_VALUE_TYPE */
+
+/* Largest difference of reduced-precision reserves from the double-precision reference, relative to the largest reference reserve */
+#if !defined(SIMULATION_REFERENCE_TOLERANCE)
+#define SIMULATION_REFERENCE_TOLERANCE 1e-4
+#endif /* !SIMULATION_REFERENCE_TOLERANCE */
 
 /* Modeled policy fields */
+template <typename VALUE_TYPE>
 struct policy_record
 {
-	double av;
-	double benefit;
+	VALUE_TYPE av;
+	VALUE_TYPE benefit;
 };
 
-/* Shorthand for policy vector type */
-typedef vector<policy_record> policy_vector_type;
+/* Modeled policy cohorts (each a count of policies with identical fields), stored field-by-field (struct of arrays) */
+/* so that projection kernels can vectorize across cohorts */
+template <typename VALUE_TYPE>
+struct policy_table
+{
+	typedef std::vector<VALUE_TYPE> real_vector_type;
+
+	real_vector_type av;
+	real_vector_type benefit;
+	real_vector_type policies;
+
+	size_t size() const
+	{
+		return av.size();
+	}
+
+	/* Total policy count over all cohorts */
+	double policy_count() const
+	{
+		return std::accumulate(policies.begin(), policies.end(), 0.0);
+	}
+
+	void reserve(size_t count)
+	{
+		av.reserve(count);
+		benefit.reserve(count);
+		policies.reserve(count);
+	}
+
+	/* Appends a cohort of identical policies (a single policy by default) */
+	void push_back(policy_record<VALUE_TYPE> const& policy, VALUE_TYPE count = 1)
+	{
+		av.push_back(policy.av);
+		benefit.push_back(policy.benefit);
+		policies.push_back(count);
+	}
+
+	/* Merges cohorts with identical policy fields, retaining the order in which distinct cohorts first appear */
+	void group_cohorts()
+	{
+		typedef std::map<std::pair<VALUE_TYPE, VALUE_TYPE>, size_t> cohort_index_type;
+
+		cohort_index_type index;
+		policy_table grouped;
+
+		for (size_t i = 0; i < size(); ++i)
+		{
+			std::pair<typename cohort_index_type::iterator, bool> insertion = index.insert(std::make_pair(std::make_pair(av[i], benefit[i]), grouped.size()));
+
+			if (insertion.second)
+			{
+				policy_record<VALUE_TYPE> policy = { av[i], benefit[i] };
+				grouped.push_back(policy, policies[i]);
+			}
+			else
+			{
+				grouped.policies[insertion.first->second] += policies[i];
+			}
+		}
+
+		std::swap(*this, grouped);
+	}
+};
 
 /* Simulation inputs (read-only during simulation phase) */
+template <typename VALUE_TYPE>
 struct simulation_input
 {
-	real_vector_type mortality;
-	real_vector_type survival;
-	real_vector_type yield;
-	policy_vector_type inforce;
+	std::vector<VALUE_TYPE> mortality;
+	std::vector<VALUE_TYPE> survival;
+	yield_curves<VALUE_TYPE> yield;
+	policy_table<VALUE_TYPE> inforce;
 };
 
 /* Simulation output(s) (mutable during simulation phase) */
+template <typename VALUE_TYPE>
 struct simulation_output
 {
-	real_vector_type reserves;
+	std::vector<VALUE_TYPE> reserves;
 };
 
-/* Boost function object called to execute parallel tasks */
-class simulation_tasks
+/* Per-scenario, per-cohort deficiencies, of which those found in a deficiency cache are reused rather than projected */
+/* A cell is reused when both its scenario (keyed by its returns) and its cohort (keyed by policy fields) are cached, so that only */
+/* new or edited scenarios are projected over all cohorts, and only new or edited cohorts are projected over other scenarios */
+/* Every scenario's reserve, whether projected in full or in part, is aggregated from its row of deficiencies by the same */
+/* loop in cohort order, so that reserves don't depend on which cells happened to be cached */
+/* Deficiencies are cached in double precision whatever the value type, and keys cover values as projected, so that */
+/* cells are only reused by builds projecting in the same precision */
+template <typename VALUE_TYPE>
+class incremental_projection
 {
 public:
-	/* Required of function object */
-	typedef size_t result_type;
+	typedef std::vector<VALUE_TYPE> real_vector_type;
+	typedef typename projection_kernel<VALUE_TYPE>::type kernel_type;
 
 public:
-	/* Constructor assigns task count and references to synchronization helper, read-only input and muable output */
-	simulation_tasks(size_t count, latch* synchronizer, simulation_input const* input, simulation_output* output) :
-		count_(count),
-		synchronizer_(synchronizer),
-		input_(input),
-		output_(output)
+	incremental_projection() :
+		cohort_count_(0),
+		model_key_(0),
+		cached_cells_(0)
 	{
-		assert(input != NULL);
-		assert(output != NULL);
 	}
 
-	/* Required of function object (bound to task number in scheduling loop) */
-	result_type operator ()(size_t task_number)
+public:
+	/* Keys all scenarios and cohorts of the input, loading every cell available from the cache */
+	void prepare(simulation_input<VALUE_TYPE> const& input, deficiency_cache& cache)
 	{
-		assert(task_number < count_);
+		real_vector_type model(input.survival.begin(), input.survival.begin() + TIMESTEP_COUNT);
+		model.push_back(static_cast<VALUE_TYPE>(PROJECTION_MODEL_REVISION));
+		model_key_ = content_key(&model[0], model.size());
 
-		double reserve = 0.0;
-		double yield = input().yield[task_number];
+		bool loaded = cache.load(model_key_);
 
-		/* Loop over policies */
-		for (policy_vector_type::const_iterator policy_iter = input().inforce.begin(); policy_iter != input().inforce.end(); ++policy_iter)
+		size_t scenario_count = input.yield.size();
+		cohort_count_ = input.inforce.size();
+
+		scenario_keys_.resize(scenario_count);
+		scenario_cached_.assign(scenario_count, false);
+		cohort_keys_.resize(cohort_count_);
+		deficiencies_.assign(scenario_count * cohort_count_, 0.0);
+
+		std::vector<size_t> cached_cohorts(cohort_count_, deficiency_cache::npos);
+		uncached_ = policy_table<VALUE_TYPE>();
+		uncached_index_.clear();
+
+		for (size_t j = 0; j < cohort_count_; ++j)
 		{
-			double compounded_yield = 1.0;
-			double deficiency = 0.0;
-			double av = 1.0;
+			VALUE_TYPE fields[] = { input.inforce.av[j], input.inforce.benefit[j] };
+			cohort_keys_[j] = content_key(fields, sizeof(fields) / sizeof(fields[0]));
+			cached_cohorts[j] = loaded ? cache.find_cohort(cohort_keys_[j]) : deficiency_cache::npos;
 
-			/* Loop over timesteps */
-			for (size_t timestep = 0; timestep < TIMESTEP_COUNT; ++timestep)
+			/* Uncached cohorts are gathered (each as a single policy) for projection against cached scenarios */
+			if (cached_cohorts[j] == deficiency_cache::npos)
 			{
-				double charge = av * policy_iter->av;
+				policy_record<VALUE_TYPE> policy = { input.inforce.av[j], input.inforce.benefit[j] };
+				uncached_.push_back(policy);
+				uncached_index_.push_back(j);
+			}
+		}
 
-				av -= charge;
-				av *= yield;
+		cached_cells_ = 0;
 
-				double benefit = (policy_iter->benefit - av) * input().survival[timestep];
+		for (size_t i = 0; i < scenario_count; ++i)
+		{
+			scenario_keys_[i] = content_key(input.yield.returns(i), input.yield.columns());
+			size_t cached_scenario = loaded ? cache.find_scenario(scenario_keys_[i]) : deficiency_cache::npos;
+
+			if (cached_scenario == deficiency_cache::npos)
+			{
+				continue;
+			}
 
-				compounded_yield *= yield;
-				double exposure = (benefit - charge) / compounded_yield;
+			scenario_cached_[i] = true;
 
-				if (exposure > deficiency)
+			for (size_t j = 0; j < cohort_count_; ++j)
+			{
+				if (cached_cohorts[j] != deficiency_cache::npos)
 				{
-					deficiency = exposure;
+					deficiencies_[i * cohort_count_ + j] = static_cast<VALUE_TYPE>(cache.deficiency(cached_scenario, cached_cohorts[j]));
+					++cached_cells_;
 				}
 			}
+		}
+	}
+
+	/* Projects the uncached cells of one scenario and returns its reserve (safe to call concurrently for distinct scenarios) */
+	VALUE_TYPE project(size_t scenario, kernel_type kernel, simulation_input<VALUE_TYPE> const& input, VALUE_TYPE const* yields, VALUE_TYPE const* compounded_yields)
+	{
+		VALUE_TYPE* row = &deficiencies_[scenario * cohort_count_];
+		policy_table<VALUE_TYPE> const& inforce = input.inforce;
+
+		if (!scenario_cached_[scenario])
+		{
+			/* Nothing is known of the scenario, so it is projected over all cohorts */
+			kernel(yields, compounded_yields, &input.survival[0], TIMESTEP_COUNT, &inforce.av[0], &inforce.benefit[0], &inforce.policies[0], cohort_count_, row);
+		}
+		else if (!uncached_index_.empty())
+		{
+			/* Deficiencies of the uncached cohorts are projected into a buffer kept by each worker (like its yields), */
+			/* allocated on the worker's first call rather than for every scenario */
+			static thread_local real_vector_type projected;
+
+			if (projected.size() < uncached_index_.size())
+			{
+				projected.resize(uncached_index_.size());
+			}
+
+			kernel(yields, compounded_yields, &input.survival[0], TIMESTEP_COUNT, &uncached_.av[0], &uncached_.benefit[0], &uncached_.policies[0], uncached_.size(), &projected[0]);
+
+			for (size_t k = 0; k < uncached_index_.size(); ++k)
+			{
+				row[uncached_index_[k]] = projected[k];
+			}
+		}
+
+		VALUE_TYPE reserve = 0;
 
-			/* Accumulate total reserves over all policies */
-			reserve += deficiency;
+		for (size_t j = 0; j < cohort_count_; ++j)
+		{
+			reserve += row[j] * inforce.policies[j];
 		}
 
+		return reserve;
+	}
+
+	/* Replaces the cache content with the deficiencies of the current input (all of which are known after a sample) */
+	void store(deficiency_cache const& cache) const
+	{
+		cache.store(model_key_, scenario_keys_, cohort_keys_, std::vector<double>(deficiencies_.begin(), deficiencies_.end()));
+	}
+
+	size_t cached_cells() const
+	{
+		return cached_cells_;
+	}
+
+	size_t cell_count() const
+	{
+		return deficiencies_.size();
+	}
+
+private:
+	size_t cohort_count_;
+	uint64_t model_key_;
+	size_t cached_cells_;
+	std::vector<uint64_t> scenario_keys_;
+	std::vector<bool> scenario_cached_;
+	std::vector<uint64_t> cohort_keys_;
+	policy_table<VALUE_TYPE> uncached_;
+	std::vector<size_t> uncached_index_;
+	real_vector_type deficiencies_;
+};
+
+/* Boost function object called to execute parallel tasks */
+template <typename VALUE_TYPE>
+class simulation_tasks
+{
+public:
+	/* Required of function object */
+	typedef size_t result_type;
+
+	typedef std::vector<VALUE_TYPE> real_vector_type;
+	typedef typename projection_kernel<VALUE_TYPE>::type kernel_type;
+
+public:
+	/* Constructor assigns task count, projection kernel and references to read-only input (one replica per node) and muable output */
+	/* Given an incremental projection, only deficiencies it lacks are projected */
+	simulation_tasks(size_t count, kernel_type kernel, simulation_input<VALUE_TYPE> const* inputs, size_t input_count, simulation_output<VALUE_TYPE>* output, incremental_projection<VALUE_TYPE>* increment = NULL) :
+		count_(count),
+		kernel_(kernel),
+		inputs_(inputs),
+		input_count_(input_count),
+		output_(output),
+		increment_(increment)
+	{
+		assert(inputs != NULL);
+		assert(input_count > 0);
+		assert(output != NULL);
+	}
+
+	/* Required of function object (bound to task number in scheduling loop) */
+	result_type operator ()(size_t task_number)
+	{
+		assert(task_number < count_);
+
+		simulation_input<VALUE_TYPE> const& local = input();
+
+		/* Yields and their compounding are computed once per scenario, then shared by all policy cohorts */
+		static thread_local real_vector_type yields(TIMESTEP_COUNT);
+		static thread_local real_vector_type compounded_yields(TIMESTEP_COUNT);
+
+		{
+			TRACE_SPAN("project_yields");
+			local.yield.project_yields(task_number, &yields[0], &compounded_yields[0]);
+		}
+
+		/* Project all policy cohorts over all timesteps, accumulating total reserves over all policies */
+		TRACE_SPAN("project_cohorts");
+		VALUE_TYPE reserve = (increment_ != NULL) ?
+			increment_->project(task_number, kernel_, local, &yields[0], &compounded_yields[0]) :
+			kernel_(&yields[0], &compounded_yields[0], &local.survival[0], TIMESTEP_COUNT, &local.inforce.av[0], &local.inforce.benefit[0], &local.inforce.policies[0], local.inforce.size(), NULL);
+
 		/* Commit reserve for given scenario */
 		output().reserves[task_number] = reserve;
 
-		/* Deduct number of outstanding scenario-specific parallel calculations */
-		synchronizer_->count_down();
-
 		return task_number;
 	}
 
-	/* Convenience accessor */
-	simulation_input const& input() const
+	/* Convenience accessor (selects the replica local to the calling worker's node) */
+	simulation_input<VALUE_TYPE> const& input() const
 	{
-		return *input_;
+		return inputs_[thread_placement::current_node() % input_count_];
 	}
 
 	/* Convenience accessor */
-	simulation_output& output()
+	simulation_output<VALUE_TYPE>& output()
 	{
 		return *output_;
 	}
 
 private:
 	size_t count_;
-	latch* synchronizer_;
-	simulation_input const* input_;
-	simulation_output* output_;
+	kernel_type kernel_;
+	simulation_input<VALUE_TYPE> const* inputs_;
+	size_t input_count_;
+	simulation_output<VALUE_TYPE>* output_;
+	incremental_projection<VALUE_TYPE>* increment_;
 };
 
 class profiler_subject
 {
 protected:
-	profiler_subject()
+	typedef SIMULATION_VALUE_TYPE value_type;
+	typedef projection_kernel<value_type>::type kernel_type;
+	typedef simulation_input<value_type> input_type;
+	typedef simulation_output<value_type> output_type;
+
+	/* Reduced-precision builds check reserves against a double-precision reference */
+	static const bool CHECK_REFERENCE = !std::is_same<value_type, double>::value;
+
+protected:
+	profiler_subject(size_t threads = 0, placement::policy policy = placement::unpinned, std::string const& cache_directory = std::string()) :
+		placement_(policy),
+		parallelizer_(threads, placement_),
+		kernel_(&project_policies_scalar<value_type>),
+		cache_directory_(cache_directory)
 	{
 	}
 
@@ -162,32 +406,34 @@ protected:
 
 private:
 	/* Helper to load tabular CSV source into 1D vector */
-	void load_1d_csv(vector<double>& target, char const* filename)
+	template <typename VALUE_TYPE>
+	void load_1d_csv(std::vector<VALUE_TYPE>& target, char const* filename)
 	{
-		boost::numeric::ublas::matrix<double> intermediate;
+		boost::numeric::ublas::matrix<VALUE_TYPE> intermediate;
 		load_dense_data(intermediate, filename);
 
 		assert(intermediate.size2() == 1);
-		boost::numeric::ublas::matrix_column<boost::numeric::ublas::matrix<double>> slice = boost::numeric::ublas::column(intermediate, 0);
+		boost::numeric::ublas::matrix_column<boost::numeric::ublas::matrix<VALUE_TYPE>> slice = boost::numeric::ublas::column(intermediate, 0);
 
 		target.resize(intermediate.size1());
 		target.assign(slice.begin(), slice.end());
 	}
 
-	/* Helper just for input data */
-	void prepare_input(simulation_input& input)
+	/* Helper just for input data (prepared at the model's precision, and in double precision for the reference) */
+	template <typename VALUE_TYPE>
+	void prepare_input(simulation_input<VALUE_TYPE>& input)
 	{
 		/* Load vectorized data from disk */
 		load_1d_csv(input.mortality, "mortality.csv");
-		load_1d_csv(input.yield, "sigma.csv");
+		input.yield.load("sigma.csv", TIMESTEP_COUNT);
 		
 		input.survival.reserve(std::max(input.mortality.size(), TIMESTEP_COUNT));
 
 		/* Calculate survival by timestep from mortality rates */
-		double survival = 1.0;
-		for (real_vector_type::const_iterator iter = input.mortality.begin(); iter != input.mortality.end(); ++iter)
+		VALUE_TYPE survival = 1;
+		for (typename std::vector<VALUE_TYPE>::const_iterator iter = input.mortality.begin(); iter != input.mortality.end(); ++iter)
 		{
-			survival *= 1.0 - (*iter);
+			survival *= 1 - (*iter);
 			/* REVIEW: is application of mortality rate correct? */
 			input.survival.push_back(survival * (*iter));
 		}
@@ -198,27 +444,97 @@ private:
 			input.survival.push_back(0.0);
 		}
 
-		/* Adjust returns by 1.0 */
-		for (real_vector_type::iterator iter = input.yield.begin(); iter != input.yield.end(); ++iter)
+		/* Synthesize (invariant) policy data */
+		policy_record<VALUE_TYPE> policy;
+		policy.av = static_cast<VALUE_TYPE>(0.02 / 12.0);
+		policy.benefit = 1000;
+
+		input.inforce.reserve(POLICY_COUNT);
+		while (input.inforce.size() < POLICY_COUNT)
+		{
+			input.inforce.push_back(policy);
+		}
+
+		/* Identical policies are projected once per scenario, as a cohort */
+		input.inforce.group_cohorts();
+	}
+
+	/* Copies input once per node, each copy made by a thread pinned to its node so that its pages are first touched */
+	/* (and so allocated) locally; with unpinned placement or a single node, no copy would be more local than the input */
+	/* itself, so none is made */
+	void replicate_input(input_type const& input, std::vector<input_type>& replicas)
+	{
+		replicas.clear();
+
+		if ((placement_.get_policy() == placement::unpinned) || (placement_.node_count() < 2))
 		{
-			*iter += 1.0;
+			return;
 		}
 
-		/* Synthesize (invariant) policy data */
-		input.inforce.resize(POLICY_COUNT);
-		for (policy_vector_type::iterator iter = input.inforce.begin(); iter != input.inforce.end(); ++iter)
+		replicas.resize(placement_.node_count());
+
+		for (size_t node = 0; node < replicas.size(); ++node)
 		{
-			iter->av = 0.02 / 12.0;
-			iter->benefit = 1000;
+			boost::thread replicator(boost::bind(&profiler_subject::replicate_on_node, this, node, &input, &replicas[node]));
+			replicator.join();
 		}
 	}
 
+	void replicate_on_node(size_t node, input_type const* input, input_type* replica)
+	{
+		placement_.pin_to_node(node);
+		*replica = *input;
+	}
+
 	/* Helper just for output data */
-	void prepare_output(simulation_input const& input, simulation_output& output)
+	void prepare_output(input_type const& input, output_type& output)
 	{
 		output.reserves.resize(input.yield.size());
 	}
 
+	/* Projects every scenario in double precision with the scalar kernel, as the reference for reduced-precision reserves */
+	void prepare_reference()
+	{
+		TRACE_SPAN("prepare_reference");
+		simulation_input<double> input;
+		std::vector<double> yields(TIMESTEP_COUNT);
+		std::vector<double> compounded_yields(TIMESTEP_COUNT);
+
+		prepare_input(input);
+		reference_.resize(input.yield.size());
+
+		for (size_t scenario = 0; scenario < reference_.size(); ++scenario)
+		{
+			input.yield.project_yields(scenario, &yields[0], &compounded_yields[0]);
+			reference_[scenario] = project_policies_scalar<double>(&yields[0], &compounded_yields[0], &input.survival[0], TIMESTEP_COUNT, &input.inforce.av[0], &input.inforce.benefit[0], &input.inforce.policies[0], input.inforce.size());
+		}
+	}
+
+	/* Compares reserves with the double-precision reference, throwing if they differ by more than the tolerance */
+	void check_reference()
+	{
+		TRACE_SPAN("check_reference");
+		double largest_difference = 0.0;
+		double largest_magnitude = 0.0;
+
+		for (size_t scenario = 0; scenario < reference_.size(); ++scenario)
+		{
+			largest_difference = std::max(largest_difference, std::abs(static_cast<double>(output_.reserves[scenario]) - reference_[scenario]));
+			largest_magnitude = std::max(largest_magnitude, std::abs(reference_[scenario]));
+		}
+
+		double relative_difference = (largest_magnitude > 0.0) ? largest_difference / largest_magnitude : largest_difference;
+
+		progress_line() << "reserves differ from double-precision reference by " << relative_difference << " (relative to largest magnitude)" << std::endl;
+
+		if (!(relative_difference <= SIMULATION_REFERENCE_TOLERANCE))
+		{
+			std::ostringstream message;
+			message << "Reserves differ from double-precision reference by " << relative_difference << ", beyond tolerance of " << SIMULATION_REFERENCE_TOLERANCE;
+			throw std::runtime_error(message.str());
+		}
+	}
+
 protected:
 	/* Setup prepares input and output structures for all trials */
 	void setup()
@@ -227,7 +543,43 @@ protected:
 
 		prepare_input(input_);
 		prepare_output(input_, output_);
+		replicate_input(input_, replicas_);
+
+		if (CHECK_REFERENCE)
+		{
+			progress_line("preparing double-precision reference...") << std::endl;
+			prepare_reference();
+		}
+
+#if defined(USE_INCREMENTAL_SIMULATION)
+		deficiency_cache cache(cache_directory_, DEFICIENCY_CACHE_FILENAME);
+		increment_.prepare(input_, cache);
+#endif /* USE_INCREMENTAL_SIMULATION */
 
+		char const* kernel_name = NULL;
+		kernel_ = select_projection_kernel<value_type>(&kernel_name);
+		progress_line() << "using " << kernel_name << " projection kernel (" << (8 * sizeof(value_type)) << "-bit values)" << std::endl;
+
+		if (replicas_.empty())
+		{
+			progress_line() << "sharing input across all workers (not replicated)" << std::endl;
+		}
+		else
+		{
+			progress_line() << "replicated input across " << replicas_.size() << " node(s)" << std::endl;
+		}
+
+		progress_line() << "grouped " << input_.inforce.policy_count() << " policies into " << input_.inforce.size() << " cohort(s)" << std::endl;
+#if defined(USE_INCREMENTAL_SIMULATION)
+		if (cache_directory_.empty())
+		{
+			progress_line() << "projecting all scenario-cohort deficiencies (no cache directory given, so none are reused or saved)" << std::endl;
+		}
+		else
+		{
+			progress_line() << "reusing " << increment_.cached_cells() << " of " << increment_.cell_count() << " cached scenario-cohort deficiencies" << std::endl;
+		}
+#endif /* USE_INCREMENTAL_SIMULATION */
 		progress_line("data preparation complete") << std::endl;
 	}
 
@@ -241,23 +593,48 @@ protected:
 	{
 		size_t scenario_count = output_.reserves.size();
 
+		/* Without replicas, every worker reads the input itself */
+		input_type const* inputs = replicas_.empty() ? &input_ : &replicas_[0];
+		size_t input_count = replicas_.empty() ? 1 : replicas_.size();
+
 		/* Prepare tasks one-to-one with scenarios */
-		latch synchonizer(scenario_count);
-		simulation_tasks tasks(scenario_count, &synchonizer, &input_, &output_);
+		/* Each task assigns the reserve of its scenario, so reserves need not be zeroed beforehand */
+#if defined(USE_INCREMENTAL_SIMULATION)
+		simulation_tasks<value_type> tasks(scenario_count, kernel_, inputs, input_count, &output_, &increment_);
+#else
+		simulation_tasks<value_type> tasks(scenario_count, kernel_, inputs, input_count, &output_);
+#endif /* USE_INCREMENTAL_SIMULATION */
 
-		/* Zero reserves across all scenarios */
-		fill(output_.reserves.begin(), output_.reserves.end(), 0.0);
+		/* Scenarios are scheduled one tile at a time (a single tile unless yield curves are too large to hold in memory), */
+		/* with the next tile's yields paged in while the current tile is projected */
+		yield_curves<value_type> const& curves = input_.yield;
+		size_t tile = curves.tile_size();
 
-		/* Loop over scenarios */
-		for (size_t i = 0; i < scenario_count; ++i)
+		curves.prefetch(0, std::min(tile, scenario_count));
+
+		for (size_t first = 0; first < scenario_count; first += tile)
 		{
-			/* Schedule each task (all-tasks object bound to a scenario selector (task number) */
-			parallelizer_.post(boost::bind(tasks, i));
-		}
+			size_t last = std::min(first + tile, scenario_count);
+			parallelism::completion_latch synchonizer(last - first);
+
+			curves.prefetch(last, std::min(last + tile, scenario_count));
+
+			/* Schedule all tasks of the tile (all-tasks object called with each scenario selector (task number)) */
+			/* Outstanding scenario-specific parallel calculations are deducted from the synchronizer as they complete */
+			{
+				TRACE_SPAN("post_range");
+				parallelizer_.post_range(last - first, parallelism::offset_task<simulation_tasks<value_type> >(tasks, first), synchonizer);
+			}
+
+			/* Tile is not complete until all tasks are complete */
+			/* Note the thread pool itsef remains populated for the next tile and trial */
+			{
+				TRACE_SPAN("wait_for_tile");
+				synchonizer.wait();
+			}
 
-		/* Sample is not complete until all tasks are complete */
-		/* Note the thread pool itsef remains populated for the next trial */
-		synchonizer.wait();
+			curves.release(first, last);
+		}
 	}
 
 	void end_sample(int trial)
@@ -276,31 +653,58 @@ protected:
 
 #endif /* DEBUG */
 
+		if (CHECK_REFERENCE)
+		{
+			check_reference();
+		}
+
 		progress_line() << "completed trial #" << trial << "..." << std::endl;
 	}
 
 	void teardown()
 	{
 		parallelizer_.join();
+
+#if defined(USE_INCREMENTAL_SIMULATION)
+		increment_.store(deficiency_cache(cache_directory_, DEFICIENCY_CACHE_FILENAME));
+#endif /* USE_INCREMENTAL_SIMULATION */
 	}
 
 private:
+	thread_placement placement_;
 	parallelization_type parallelizer_;
-	simulation_input input_;
-	simulation_output output_;
+	kernel_type kernel_;
+	std::string cache_directory_;
+	input_type input_;
+	std::vector<input_type> replicas_;
+	output_type output_;
+	std::vector<double> reference_;
+#if defined(USE_INCREMENTAL_SIMULATION)
+	incremental_projection<value_type> increment_;
+#endif /* USE_INCREMENTAL_SIMULATION */
 };
 
 int main(int argc, char* argv[])
 {
 	int result = 0;
-	json_output collector;
 	argv_collection arguments(argc - 1, argv + 1);
 	
 	try
 	{
 		profile_config<argv_collection::const_iterator> config(arguments.begin(), arguments.end());
-		profiler<profiler_subject, json_output> metrics(config.get_trial_count(), collector);
-		metrics.run();
+
+		/* Binary caches of parsed inputs are only kept when a cache directory is given */
+		matrix_cache_directory() = config.get_cache_directory();
+
+		with_collector(config.get_format(), "simulation", [&](auto& collector)
+		{
+			run_profiler<profiler_subject>(config.get_sampling_policy(), config.get_counters(), collector, config.get_thread_count(), config.get_placement(), config.get_cache_directory());
+		});
+
+		if (!config.get_trace_path().empty())
+		{
+			write_trace(config.get_trace_path());
+		}
 	}
 	catch (std::exception const& e)
 	{
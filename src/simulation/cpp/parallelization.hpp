@@ -2,23 +2,157 @@
 #if !defined(PARALLELIZATION_HPP_)
 #define PARALLELIZATION_HPP_
 
+#include <deque>
+#include <vector>
+#include <algorithm>
+
 #include <boost/asio.hpp>
 #include <boost/asio/thread_pool.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
+#include "thread_placement.hpp"
+#include "trace.hpp"
+
 namespace parallelism
 {
 	typedef enum
 	{
 		single_threaded = 0,
-		multi_threaded = 1
+		multi_threaded = 1,
+		work_stealing = 2
 	}
 	strategy;
+
+	/* Completion barrier for posted tasks, which (unlike boost::latch) may be counted down by many tasks at once */
+	class completion_latch
+	{
+	public:
+		completion_latch(size_t count) :
+			count_(count)
+		{
+		}
+
+		void count_down(size_t count = 1)
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+
+			count_ -= count;
+
+			if (count_ == 0)
+			{
+				ready_.notify_all();
+			}
+		}
+
+		void wait()
+		{
+			boost::unique_lock<boost::mutex> lock(mutex_);
+
+			while (count_ > 0)
+			{
+				ready_.wait(lock);
+			}
+		}
+
+	private:
+		boost::mutex mutex_;
+		boost::condition_variable ready_;
+		size_t count_;
+	};
+
+	/* Function object binding one task of a range to its index, counting down completion once run */
+	/* When tracing, the time each task spent queued (from posting until a worker takes it) is recorded as a span */
+	template <class TOKEN>
+	class indexed_task
+	{
+	public:
+		indexed_task(TOKEN token, size_t index, completion_latch* completion) :
+			token_(token),
+			index_(index),
+			completion_(completion)
+#if defined(ENABLE_TRACING)
+			, posted_(TRACE_TIMESTAMP())
+#endif /* ENABLE_TRACING */
+		{
+		}
+
+		void operator()()
+		{
+			TRACE_SPAN_SINCE("queued", posted_);
+			token_(index_);
+			completion_->count_down();
+		}
+
+	private:
+		TOKEN token_;
+		size_t index_;
+		completion_latch* completion_;
+#if defined(ENABLE_TRACING)
+		uint64_t posted_;
+#endif /* ENABLE_TRACING */
+	};
+
+	/* Function object shifting the indices of a range, so that a range may be posted in consecutive pieces */
+	template <class TOKEN>
+	class offset_task
+	{
+	public:
+		offset_task(TOKEN token, size_t offset) :
+			token_(token),
+			offset_(offset)
+		{
+		}
+
+		void operator()(size_t index)
+		{
+			token_(offset_ + index);
+		}
+
+	private:
+		TOKEN token_;
+		size_t offset_;
+	};
+
+	/* Function object adapting a task without an index to a range of one */
+	template <class TOKEN>
+	class unindexed_task
+	{
+	public:
+		unindexed_task(TOKEN token) :
+			token_(token)
+		{
+		}
+
+		void operator()(size_t /* index */)
+		{
+			token_();
+		}
+
+	private:
+		TOKEN token_;
+	};
 }
 
+/* Each strategy supports post (for a single task) and post_range (for count tasks, each passed its index in the range) */
+/* On completion of each task in a range, the given latch is counted down */
+/* Each is constructed with a worker count (zero for the strategy's default) and a placement under which workers are pinned */
 template <parallelism::strategy STRATEGY>
 class parallelization
 {
+public:
+	parallelization(size_t threads = 0, thread_placement const& placement = thread_placement()) :
+		pool_((threads > 0) ? threads : default_thread_count()),
+		placement_(placement)
+	{
+		if (placement_.get_policy() != placement::unpinned)
+		{
+			pin_workers((threads > 0) ? threads : default_thread_count());
+		}
+	}
+
 public:
 	template <class TOKEN>
 	void post(TOKEN token)
@@ -26,18 +160,68 @@ public:
 		boost::asio::post(pool_, token);
 	}
 
+	template <class TOKEN>
+	void post_range(size_t count, TOKEN token, parallelism::completion_latch& completion)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			boost::asio::post(pool_, parallelism::indexed_task<TOKEN>(token, i, &completion));
+		}
+	}
+
 	void join()
 	{
 		pool_.join();
 	}
 
+private:
+	/* Matches the default of boost::asio::thread_pool */
+	static size_t default_thread_count()
+	{
+		return 2 * std::max(1u, boost::thread::hardware_concurrency());
+	}
+
+	/* Pool threads can't be addressed directly, so one blocking task per thread is posted: each pins its thread then */
+	/* waits for all others to arrive, which guarantees that every thread takes exactly one */
+	void pin_workers(size_t threads)
+	{
+		boost::atomic<size_t> next_worker(0);
+		parallelism::completion_latch arrivals(threads);
+		parallelism::completion_latch departures(threads);
+
+		for (size_t i = 0; i < threads; ++i)
+		{
+			boost::asio::post(pool_, boost::bind(&parallelization::pin_worker, this, &next_worker, &arrivals, &departures));
+		}
+
+		/* Latches are released only once no task can still reference them */
+		departures.wait();
+	}
+
+	void pin_worker(boost::atomic<size_t>* next_worker, parallelism::completion_latch* arrivals, parallelism::completion_latch* departures)
+	{
+		placement_.pin_worker((*next_worker)++);
+
+		arrivals->count_down();
+		arrivals->wait();
+		departures->count_down();
+	}
+
 private:
 	boost::asio::thread_pool pool_;
+	thread_placement placement_;
 };
 
 template <>
 class parallelization<parallelism::single_threaded>
 {
+public:
+	/* Tasks run on the calling thread, which is pinned as the only worker */
+	parallelization(size_t /* threads */ = 0, thread_placement const& placement = thread_placement())
+	{
+		placement.pin_worker(0);
+	}
+
 public:
 	template <class TOKEN>
 	void post(TOKEN token)
@@ -45,9 +229,270 @@ public:
 		token();
 	}
 
+	template <class TOKEN>
+	void post_range(size_t count, TOKEN token, parallelism::completion_latch& completion)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			token(i);
+		}
+
+		completion.count_down(count);
+	}
+
+	void join()
+	{
+	}
+};
+
+/* Work-stealing strategy: each worker owns a deque of task ranges, working from the back while idle workers steal from the front */
+/* A posted range is divided evenly across workers, and each piece is split in half (leaving the upper half to be stolen) until */
+/* no larger than a grain chosen from the range size; the latch is counted down once per executed grain rather than per task */
+template <>
+class parallelization<parallelism::work_stealing>
+{
+private:
+	/* Body of a posted range, shared by all pieces of the range */
+	class range_body
+	{
+	public:
+		range_body(parallelism::completion_latch* completion) :
+			completion_(completion)
+		{
+		}
+
+		virtual ~range_body()
+		{
+		}
+
+		virtual void run(size_t first, size_t last) = 0;
+
+		void complete(size_t count)
+		{
+			if (completion_ != NULL)
+			{
+				completion_->count_down(count);
+			}
+		}
+
+	private:
+		parallelism::completion_latch* completion_;
+	};
+
+	template <class TOKEN>
+	class typed_range_body : public range_body
+	{
+	public:
+		typed_range_body(TOKEN token, parallelism::completion_latch* completion) :
+			range_body(completion),
+			token_(token)
+		{
+		}
+
+		virtual void run(size_t first, size_t last)
+		{
+			for (; first < last; ++first)
+			{
+				token_(first);
+			}
+		}
+
+	private:
+		TOKEN token_;
+	};
+
+	/* Piece of a posted range */
+	struct range
+	{
+		boost::shared_ptr<range_body> body;
+		size_t first;
+		size_t last;
+		size_t grain;
+	};
+
+	/* Deque of ranges owned by one worker */
+	struct worker_queue
+	{
+		boost::mutex mutex;
+		std::deque<range> ranges;
+	};
+
+public:
+	parallelization(size_t workers = 0, thread_placement const& placement = thread_placement()) :
+		queues_(std::max<size_t>(1, (workers > 0) ? workers : boost::thread::hardware_concurrency())),
+		placement_(placement),
+		pending_(0),
+		next_queue_(0),
+		stopping_(false),
+		joined_(false)
+	{
+		for (size_t i = 0; i < queues_.size(); ++i)
+		{
+			threads_.create_thread(boost::bind(&parallelization::work, this, i));
+		}
+	}
+
+	~parallelization()
+	{
+		join();
+	}
+
+public:
+	template <class TOKEN>
+	void post(TOKEN token)
+	{
+		range piece = { boost::shared_ptr<range_body>(new typed_range_body<parallelism::unindexed_task<TOKEN>>(parallelism::unindexed_task<TOKEN>(token), NULL)), 0, 1, 1 };
+		push(next_queue_++ % queues_.size(), piece);
+	}
+
+	template <class TOKEN>
+	void post_range(size_t count, TOKEN token, parallelism::completion_latch& completion)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		/* Grains allow roughly eight steals per worker before tasks run one at a time */
+		size_t workers = queues_.size();
+		size_t grain = std::max<size_t>(1, count / (8 * workers));
+		boost::shared_ptr<range_body> body(new typed_range_body<TOKEN>(token, &completion));
+
+		for (size_t i = 0; i < workers; ++i)
+		{
+			range piece = { body, count * i / workers, count * (i + 1) / workers, grain };
+
+			if (piece.first < piece.last)
+			{
+				push(i, piece);
+			}
+		}
+	}
+
 	void join()
 	{
+		if (joined_)
+		{
+			return;
+		}
+
+		{
+			boost::lock_guard<boost::mutex> lock(idle_mutex_);
+			stopping_ = true;
+		}
+
+		idle_.notify_all();
+		threads_.join_all();
+		joined_ = true;
+	}
+
+private:
+	/* Worker loop: run own work, else steal, else sleep until work is posted (or all work is complete when joining) */
+	void work(size_t self)
+	{
+		range current;
+
+		placement_.pin_worker(self);
+
+		for (;;)
+		{
+			if (pop(self, current) || steal(self, current))
+			{
+				execute(self, current);
+				continue;
+			}
+
+			boost::unique_lock<boost::mutex> lock(idle_mutex_);
+
+			while ((pending_ == 0) && !stopping_)
+			{
+				idle_.wait(lock);
+			}
+
+			if ((pending_ == 0) && stopping_)
+			{
+				return;
+			}
+		}
+	}
+
+	/* Split off upper halves for other workers to steal until the remainder fits in a grain, then run it */
+	void execute(size_t self, range& current)
+	{
+		while (current.last - current.first > current.grain)
+		{
+			range upper = { current.body, current.first + (current.last - current.first) / 2, current.last, current.grain };
+			current.last = upper.first;
+			push(self, upper);
+		}
+
+		current.body->run(current.first, current.last);
+		current.body->complete(current.last - current.first);
+		current.body.reset();
+	}
+
+	void push(size_t queue, range const& piece)
+	{
+		/* Pending count rises under the idle lock so that a worker about to sleep can't miss the wakeup, and before the */
+		/* range is published so that a thief taking it can't decrement the count first (the count never falls below the */
+		/* number of queued ranges, at worst leaving a worker to retry until the range appears) */
+		{
+			boost::lock_guard<boost::mutex> lock(idle_mutex_);
+			++pending_;
+		}
+
+		{
+			boost::lock_guard<boost::mutex> lock(queues_[queue].mutex);
+			queues_[queue].ranges.push_back(piece);
+		}
+
+		idle_.notify_one();
+	}
+
+	bool pop(size_t self, range& piece)
+	{
+		boost::lock_guard<boost::mutex> lock(queues_[self].mutex);
+
+		if (queues_[self].ranges.empty())
+		{
+			return false;
+		}
+
+		piece = queues_[self].ranges.back();
+		queues_[self].ranges.pop_back();
+		--pending_;
+		return true;
+	}
+
+	bool steal(size_t self, range& piece)
+	{
+		for (size_t offset = 1; offset < queues_.size(); ++offset)
+		{
+			worker_queue& victim = queues_[(self + offset) % queues_.size()];
+			boost::lock_guard<boost::mutex> lock(victim.mutex);
+
+			if (!victim.ranges.empty())
+			{
+				piece = victim.ranges.front();
+				victim.ranges.pop_front();
+				--pending_;
+				return true;
+			}
+		}
+
+		return false;
 	}
+
+private:
+	std::vector<worker_queue> queues_;
+	thread_placement placement_;
+	boost::thread_group threads_;
+	boost::mutex idle_mutex_;
+	boost::condition_variable idle_;
+	boost::atomic<size_t> pending_;
+	size_t next_queue_;
+	bool stopping_;
+	bool joined_;
 };
 
 #endif /* PARALLELIZATION_HPP_ */
@@ -0,0 +1,352 @@
+#pragma once
+#if !defined(PROJECTION_HPP_)
+#define PROJECTION_HPP_
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <string.h>
+
+#include "cpu_features.hpp"
+
+#if !defined(DISABLE_VECTORIZED_KERNELS) && defined(CPU_FEATURES_AVAILABLE)
+#define VECTORIZED_KERNELS_AVAILABLE
+#endif /* !DISABLE_VECTORIZED_KERNELS && CPU_FEATURES_AVAILABLE */
+
+/* Kernels projecting a range of policy cohorts (given field-by-field) against one scenario over all timesteps, given the */
+/* scenario's yield at each timestep and (precomputed once per scenario, as they are common to all cohorts) their products */
+/* Each returns the sum of per-cohort deficiencies weighted by cohort policy count, accumulated in cohort order, and stores */
+/* each (unweighted) cohort deficiency when given a destination; all values (and all arithmetic) are of one value type */
+/* Vectorized kernels apply exactly the scalar sequence of IEEE operations in each lane, and add lanes (then any remaining */
+/* cohorts) to a single running reserve in cohort order, and so produce bit-identical results provided the compiler does */
+/* not contract multiplies and adds into FMA instructions (see CMakeLists.txt) */
+template <typename VALUE_TYPE>
+struct projection_kernel
+{
+	typedef VALUE_TYPE (*type)(VALUE_TYPE const* yields, VALUE_TYPE const* compounded_yields, VALUE_TYPE const* survival, size_t timesteps, VALUE_TYPE const* av, VALUE_TYPE const* benefit, VALUE_TYPE const* policies, size_t count, VALUE_TYPE* deficiencies);
+};
+
+/* Portable projection of one cohort at a time, adding each weighted deficiency to a running reserve (so that vectorized */
+/* kernels can continue their own running reserve over the cohorts left beyond their last full lane group) */
+template <typename VALUE_TYPE>
+inline VALUE_TYPE accumulate_policies_scalar(VALUE_TYPE reserve, VALUE_TYPE const* yields, VALUE_TYPE const* compounded_yields, VALUE_TYPE const* survival, size_t timesteps, VALUE_TYPE const* av, VALUE_TYPE const* benefit, VALUE_TYPE const* policies, size_t count, VALUE_TYPE* deficiencies)
+{
+	/* Loop over cohorts */
+	for (size_t policy = 0; policy < count; ++policy)
+	{
+		VALUE_TYPE deficiency = 0;
+		VALUE_TYPE value = 1;
+
+		/* Loop over timesteps */
+		for (size_t timestep = 0; timestep < timesteps; ++timestep)
+		{
+			VALUE_TYPE charge = value * av[policy];
+
+			value -= charge;
+			value *= yields[timestep];
+
+			VALUE_TYPE payout = (benefit[policy] - value) * survival[timestep];
+			VALUE_TYPE exposure = (payout - charge) / compounded_yields[timestep];
+
+			if (exposure > deficiency)
+			{
+				deficiency = exposure;
+			}
+		}
+
+		if (deficiencies != NULL)
+		{
+			deficiencies[policy] = deficiency;
+		}
+
+		/* Accumulate total reserves over all policies (identical policies in a cohort share a deficiency) */
+		reserve += deficiency * policies[policy];
+	}
+
+	return reserve;
+}
+
+/* Portable kernel, one cohort at a time */
+template <typename VALUE_TYPE>
+inline VALUE_TYPE project_policies_scalar(VALUE_TYPE const* yields, VALUE_TYPE const* compounded_yields, VALUE_TYPE const* survival, size_t timesteps, VALUE_TYPE const* av, VALUE_TYPE const* benefit, VALUE_TYPE const* policies, size_t count, VALUE_TYPE* deficiencies = NULL)
+{
+	return accumulate_policies_scalar<VALUE_TYPE>(0, yields, compounded_yields, survival, timesteps, av, benefit, policies, count, deficiencies);
+}
+
+#if defined(VECTORIZED_KERNELS_AVAILABLE)
+
+/* AVX2 kernel, four cohorts per lane group */
+CPU_TARGET("avx2")
+inline double project_policies_avx2(double const* yields, double const* compounded_yields, double const* survival, size_t timesteps, double const* av, double const* benefit, double const* policies, size_t count, double* deficiencies = NULL)
+{
+	const size_t LANES = 4;
+
+	double reserve = 0.0;
+	size_t policy = 0;
+
+	for (; policy + LANES <= count; policy += LANES)
+	{
+		__m256d policy_av = _mm256_loadu_pd(av + policy);
+		__m256d policy_benefit = _mm256_loadu_pd(benefit + policy);
+		__m256d deficiency = _mm256_setzero_pd();
+		__m256d value = _mm256_set1_pd(1.0);
+
+		for (size_t timestep = 0; timestep < timesteps; ++timestep)
+		{
+			__m256d charge = _mm256_mul_pd(value, policy_av);
+
+			value = _mm256_sub_pd(value, charge);
+			value = _mm256_mul_pd(value, _mm256_set1_pd(yields[timestep]));
+
+			__m256d payout = _mm256_mul_pd(_mm256_sub_pd(policy_benefit, value), _mm256_set1_pd(survival[timestep]));
+
+			__m256d exposure = _mm256_div_pd(_mm256_sub_pd(payout, charge), _mm256_set1_pd(compounded_yields[timestep]));
+
+			/* Operand order matches the scalar comparison (exposure > deficiency) */
+			deficiency = _mm256_max_pd(exposure, deficiency);
+		}
+
+		if (deficiencies != NULL)
+		{
+			_mm256_storeu_pd(deficiencies + policy, deficiency);
+		}
+
+		double weighted[LANES];
+		_mm256_storeu_pd(weighted, _mm256_mul_pd(deficiency, _mm256_loadu_pd(policies + policy)));
+
+		for (size_t lane = 0; lane < LANES; ++lane)
+		{
+			reserve += weighted[lane];
+		}
+	}
+
+	/* Remaining cohorts continue the same running reserve, so that the sum is associated exactly as in the scalar kernel */
+	return accumulate_policies_scalar<double>(reserve, yields, compounded_yields, survival, timesteps, av + policy, benefit + policy, policies + policy, count - policy, (deficiencies != NULL) ? (deficiencies + policy) : NULL);
+}
+
+/* AVX2 kernel, eight single-precision cohorts per lane group */
+CPU_TARGET("avx2")
+inline float project_policies_avx2(float const* yields, float const* compounded_yields, float const* survival, size_t timesteps, float const* av, float const* benefit, float const* policies, size_t count, float* deficiencies = NULL)
+{
+	const size_t LANES = 8;
+
+	float reserve = 0.0f;
+	size_t policy = 0;
+
+	for (; policy + LANES <= count; policy += LANES)
+	{
+		__m256 policy_av = _mm256_loadu_ps(av + policy);
+		__m256 policy_benefit = _mm256_loadu_ps(benefit + policy);
+		__m256 deficiency = _mm256_setzero_ps();
+		__m256 value = _mm256_set1_ps(1.0f);
+
+		for (size_t timestep = 0; timestep < timesteps; ++timestep)
+		{
+			__m256 charge = _mm256_mul_ps(value, policy_av);
+
+			value = _mm256_sub_ps(value, charge);
+			value = _mm256_mul_ps(value, _mm256_set1_ps(yields[timestep]));
+
+			__m256 payout = _mm256_mul_ps(_mm256_sub_ps(policy_benefit, value), _mm256_set1_ps(survival[timestep]));
+
+			__m256 exposure = _mm256_div_ps(_mm256_sub_ps(payout, charge), _mm256_set1_ps(compounded_yields[timestep]));
+
+			/* Operand order matches the scalar comparison (exposure > deficiency) */
+			deficiency = _mm256_max_ps(exposure, deficiency);
+		}
+
+		if (deficiencies != NULL)
+		{
+			_mm256_storeu_ps(deficiencies + policy, deficiency);
+		}
+
+		float weighted[LANES];
+		_mm256_storeu_ps(weighted, _mm256_mul_ps(deficiency, _mm256_loadu_ps(policies + policy)));
+
+		for (size_t lane = 0; lane < LANES; ++lane)
+		{
+			reserve += weighted[lane];
+		}
+	}
+
+	return accumulate_policies_scalar<float>(reserve, yields, compounded_yields, survival, timesteps, av + policy, benefit + policy, policies + policy, count - policy, (deficiencies != NULL) ? (deficiencies + policy) : NULL);
+}
+
+/* AVX-512 kernel, eight cohorts per lane group */
+CPU_TARGET("avx512f")
+inline double project_policies_avx512(double const* yields, double const* compounded_yields, double const* survival, size_t timesteps, double const* av, double const* benefit, double const* policies, size_t count, double* deficiencies = NULL)
+{
+	const size_t LANES = 8;
+
+	double reserve = 0.0;
+	size_t policy = 0;
+
+	for (; policy + LANES <= count; policy += LANES)
+	{
+		__m512d policy_av = _mm512_loadu_pd(av + policy);
+		__m512d policy_benefit = _mm512_loadu_pd(benefit + policy);
+		__m512d deficiency = _mm512_setzero_pd();
+		__m512d value = _mm512_set1_pd(1.0);
+
+		for (size_t timestep = 0; timestep < timesteps; ++timestep)
+		{
+			__m512d charge = _mm512_mul_pd(value, policy_av);
+
+			value = _mm512_sub_pd(value, charge);
+			value = _mm512_mul_pd(value, _mm512_set1_pd(yields[timestep]));
+
+			__m512d payout = _mm512_mul_pd(_mm512_sub_pd(policy_benefit, value), _mm512_set1_pd(survival[timestep]));
+
+			__m512d exposure = _mm512_div_pd(_mm512_sub_pd(payout, charge), _mm512_set1_pd(compounded_yields[timestep]));
+
+			/* Operand order matches the scalar comparison (exposure > deficiency); the masked form (over all lanes) is used as */
+			/* _mm512_max_pd passes an undefined vector through to the builtin, which GCC reports as maybe-uninitialized */
+			deficiency = _mm512_mask_max_pd(deficiency, 0xFF, exposure, deficiency);
+		}
+
+		if (deficiencies != NULL)
+		{
+			_mm512_storeu_pd(deficiencies + policy, deficiency);
+		}
+
+		double weighted[LANES];
+		_mm512_storeu_pd(weighted, _mm512_mul_pd(deficiency, _mm512_loadu_pd(policies + policy)));
+
+		for (size_t lane = 0; lane < LANES; ++lane)
+		{
+			reserve += weighted[lane];
+		}
+	}
+
+	/* Remaining cohorts continue the same running reserve, so that the sum is associated exactly as in the scalar kernel */
+	return accumulate_policies_scalar<double>(reserve, yields, compounded_yields, survival, timesteps, av + policy, benefit + policy, policies + policy, count - policy, (deficiencies != NULL) ? (deficiencies + policy) : NULL);
+}
+
+/* AVX-512 kernel, sixteen single-precision cohorts per lane group */
+CPU_TARGET("avx512f")
+inline float project_policies_avx512(float const* yields, float const* compounded_yields, float const* survival, size_t timesteps, float const* av, float const* benefit, float const* policies, size_t count, float* deficiencies = NULL)
+{
+	const size_t LANES = 16;
+
+	float reserve = 0.0f;
+	size_t policy = 0;
+
+	for (; policy + LANES <= count; policy += LANES)
+	{
+		__m512 policy_av = _mm512_loadu_ps(av + policy);
+		__m512 policy_benefit = _mm512_loadu_ps(benefit + policy);
+		__m512 deficiency = _mm512_setzero_ps();
+		__m512 value = _mm512_set1_ps(1.0f);
+
+		for (size_t timestep = 0; timestep < timesteps; ++timestep)
+		{
+			__m512 charge = _mm512_mul_ps(value, policy_av);
+
+			value = _mm512_sub_ps(value, charge);
+			value = _mm512_mul_ps(value, _mm512_set1_ps(yields[timestep]));
+
+			__m512 payout = _mm512_mul_ps(_mm512_sub_ps(policy_benefit, value), _mm512_set1_ps(survival[timestep]));
+
+			__m512 exposure = _mm512_div_ps(_mm512_sub_ps(payout, charge), _mm512_set1_ps(compounded_yields[timestep]));
+
+			/* Masked over all lanes, as for double precision */
+			deficiency = _mm512_mask_max_ps(deficiency, 0xFFFF, exposure, deficiency);
+		}
+
+		if (deficiencies != NULL)
+		{
+			_mm512_storeu_ps(deficiencies + policy, deficiency);
+		}
+
+		float weighted[LANES];
+		_mm512_storeu_ps(weighted, _mm512_mul_ps(deficiency, _mm512_loadu_ps(policies + policy)));
+
+		for (size_t lane = 0; lane < LANES; ++lane)
+		{
+			reserve += weighted[lane];
+		}
+	}
+
+	return accumulate_policies_scalar<float>(reserve, yields, compounded_yields, survival, timesteps, av + policy, benefit + policy, policies + policy, count - policy, (deficiencies != NULL) ? (deficiencies + policy) : NULL);
+}
+
+#endif /* VECTORIZED_KERNELS_AVAILABLE */
+
+/* Checks that a kernel reproduces the scalar kernel exactly (every deficiency and the reserve, bit for bit) over synthetic */
+/* cohorts, for every count up to two full lane groups and a tail, throwing if it does not */
+template <typename VALUE_TYPE>
+inline void verify_projection_kernel(typename projection_kernel<VALUE_TYPE>::type kernel, size_t lanes, char const* name)
+{
+	const size_t TIMESTEPS = 120;
+	const size_t COUNT = 2 * lanes + 1;
+
+	std::vector<VALUE_TYPE> yields(TIMESTEPS), compounded_yields(TIMESTEPS), survival(TIMESTEPS);
+	std::vector<VALUE_TYPE> av(COUNT), benefit(COUNT), policies(COUNT);
+	VALUE_TYPE compounded_yield = 1;
+
+	for (size_t timestep = 0; timestep < TIMESTEPS; ++timestep)
+	{
+		yields[timestep] = static_cast<VALUE_TYPE>(1.0 + 0.004 * (static_cast<double>((timestep * 7) % 11) - 5.0));
+		compounded_yield *= yields[timestep];
+		compounded_yields[timestep] = compounded_yield;
+		survival[timestep] = static_cast<VALUE_TYPE>(1.0 - static_cast<double>(timestep) / (2.0 * TIMESTEPS));
+	}
+
+	/* Fractional, distinct policy counts make the reserve sensitive to the order in which cohorts are summed */
+	for (size_t policy = 0; policy < COUNT; ++policy)
+	{
+		av[policy] = static_cast<VALUE_TYPE>(0.0005 * static_cast<double>(1 + policy % 5));
+		benefit[policy] = static_cast<VALUE_TYPE>(0.8 + 0.07 * static_cast<double>(policy));
+		policies[policy] = static_cast<VALUE_TYPE>(1.0 + static_cast<double>(policy) / 3.0);
+	}
+
+	for (size_t count = 0; count <= COUNT; ++count)
+	{
+		std::vector<VALUE_TYPE> expected(COUNT + 1, 0), actual(COUNT + 1, 0);
+		VALUE_TYPE expected_reserve = project_policies_scalar<VALUE_TYPE>(&yields[0], &compounded_yields[0], &survival[0], TIMESTEPS, &av[0], &benefit[0], &policies[0], count, &expected[0]);
+		VALUE_TYPE actual_reserve = kernel(&yields[0], &compounded_yields[0], &survival[0], TIMESTEPS, &av[0], &benefit[0], &policies[0], count, &actual[0]);
+
+		if ((memcmp(&expected_reserve, &actual_reserve, sizeof(VALUE_TYPE)) != 0) || (memcmp(&expected[0], &actual[0], count * sizeof(VALUE_TYPE)) != 0))
+		{
+			throw std::runtime_error(std::string("Projection kernel ") + name + " does not reproduce the scalar kernel over " + std::to_string(count) + " cohort(s)");
+		}
+	}
+}
+
+/* Selects the widest kernel for the value type supported by the running processor (with the name of the selection), having */
+/* verified that each supported kernel reproduces the scalar kernel */
+template <typename VALUE_TYPE>
+inline typename projection_kernel<VALUE_TYPE>::type select_projection_kernel(char const** name = NULL)
+{
+	typedef typename projection_kernel<VALUE_TYPE>::type kernel_type;
+
+	char const* selection = "scalar";
+	kernel_type kernel = &project_policies_scalar<VALUE_TYPE>;
+
+#if defined(VECTORIZED_KERNELS_AVAILABLE)
+	/* Every supported kernel is verified, the widest being selected */
+	if (cpu_features::has_avx2())
+	{
+		selection = "avx2";
+		kernel = static_cast<kernel_type>(&project_policies_avx2);
+		verify_projection_kernel<VALUE_TYPE>(kernel, 32 / sizeof(VALUE_TYPE), selection);
+	}
+
+	if (cpu_features::has_avx512f())
+	{
+		selection = "avx512";
+		kernel = static_cast<kernel_type>(&project_policies_avx512);
+		verify_projection_kernel<VALUE_TYPE>(kernel, 64 / sizeof(VALUE_TYPE), selection);
+	}
+#endif /* VECTORIZED_KERNELS_AVAILABLE */
+
+	if (name != NULL)
+	{
+		*name = selection;
+	}
+
+	return kernel;
+}
+
+#endif /* !PROJECTION_HPP_ */
@@ -0,0 +1,296 @@
+#pragma once
+#if !defined(YIELD_CURVES_HPP_)
+#define YIELD_CURVES_HPP_
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "mapped_file.hpp"
+#include "matrix_io.hpp"
+
+/* Limit on yield curve data copied into memory (larger data is processed in tiles, in place, from a mapped file) */
+#if !defined(YIELD_CURVE_RESIDENT_BYTES)
+#define YIELD_CURVE_RESIDENT_BYTES (size_t(1) << 30)
+#endif /* !YIELD_CURVE_RESIDENT_BYTES */
+
+/* Size of each tile of scenarios processed together when yield curves aren't resident */
+#if !defined(YIELD_CURVE_TILE_BYTES)
+#define YIELD_CURVE_TILE_BYTES (size_t(64) << 20)
+#endif /* !YIELD_CURVE_TILE_BYTES */
+
+/* Scenario yields by timestep, read from CSV with one row per scenario giving either a single (flat) return or one */
+/* return per timestep (any beyond the timestep count are ignored) */
+/* Returns are held as one contiguous row-major array, so that each scenario's path is read sequentially, and scenarios */
+/* are processed in tiles of consecutive rows; data beyond YIELD_CURVE_RESIDENT_BYTES isn't copied into memory but read */
+/* in place from a memory-mapped file, which is paged in ahead of each tile and released after it: the matrix cache when */
+/* caching is enabled, and otherwise a temporary file to which rows are spilled once parsed data exceeds the limit */
+/* Returns, and the yields computed from them, are of the given value type */
+template <typename VALUE_TYPE>
+class yield_curves
+{
+public:
+	typedef VALUE_TYPE value_type;
+
+private:
+	typedef matrix_cache<value_type> cache_type;
+
+public:
+	yield_curves() :
+		mapped_returns_(NULL),
+		scenarios_(0),
+		columns_(0),
+		timesteps_(0)
+	{
+	}
+
+public:
+	/* Loads returns for the given number of timesteps, from cache if fresh (otherwise parsing text and caching it) */
+	void load(char const* filename, size_t timesteps)
+	{
+		cache_type cache(&filename, &filename + 1);
+
+		timesteps_ = timesteps;
+		values_.clear();
+		mapped_.reset();
+		spill_.reset();
+
+		if (!map(cache))
+		{
+			/* Rows are written straight to the cache rather than held in memory, unless caching is unavailable */
+			if (cache.enabled())
+			{
+				typename cache_type::dense_row_writer writer(cache);
+				parse(filename, &writer);
+				writer.commit();
+			}
+
+			if (!map(cache))
+			{
+				parse(filename, NULL);
+				map_spill();
+				return;
+			}
+		}
+
+		if (scenarios_ * columns_ * sizeof(value_type) <= YIELD_CURVE_RESIDENT_BYTES)
+		{
+			values_.assign(mapped_returns_, mapped_returns_ + scenarios_ * columns_);
+			mapped_.reset();
+		}
+	}
+
+	size_t size() const
+	{
+		return scenarios_;
+	}
+
+	/* Returns per scenario as given (one if flat, otherwise at least one per timestep) */
+	size_t columns() const
+	{
+		return columns_;
+	}
+
+	/* Returns of one scenario as given */
+	value_type const* returns(size_t scenario) const
+	{
+		return (mapped_ ? mapped_returns_ : &values_[0]) + scenario * columns_;
+	}
+
+	/* Computes the yield (one plus return) of one scenario at each timestep, and its product over timesteps to date */
+	void project_yields(size_t scenario, value_type* yields, value_type* compounded_yields) const
+	{
+		value_type const* scenario_returns = returns(scenario);
+		size_t stride = (columns_ > 1) ? 1 : 0;
+		value_type compounded_yield = 1;
+
+		for (size_t timestep = 0; timestep < timesteps_; ++timestep)
+		{
+			value_type yield = scenario_returns[timestep * stride] + 1;
+
+			compounded_yield *= yield;
+			yields[timestep] = yield;
+			compounded_yields[timestep] = compounded_yield;
+		}
+	}
+
+	/* Scenarios per tile (all scenarios when resident) */
+	size_t tile_size() const
+	{
+		return mapped_ ? std::max<size_t>(1, YIELD_CURVE_TILE_BYTES / (columns_ * sizeof(value_type))) : std::max<size_t>(1, scenarios_);
+	}
+
+	/* Hints that a range of scenarios will be processed next */
+	void prefetch(size_t first, size_t last) const
+	{
+		if (mapped_ && (first < last))
+		{
+			mapped_->prefetch(reinterpret_cast<char const*>(returns(first)), reinterpret_cast<char const*>(returns(last)));
+		}
+	}
+
+	/* Hints that a range of scenarios has been processed */
+	void release(size_t first, size_t last) const
+	{
+		if (mapped_ && (first < last))
+		{
+			mapped_->release(reinterpret_cast<char const*>(returns(first)), reinterpret_cast<char const*>(returns(last)));
+		}
+	}
+
+private:
+	/* Temporary file holding returns parsed beyond the resident limit (removed once no longer mapped) */
+	class spill_file
+	{
+	public:
+		spill_file() :
+			path_((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("yield-curves-%%%%-%%%%-%%%%.tmp")).string()),
+			sink_(path_.c_str(), std::ios::binary | std::ios::trunc)
+		{
+			if (!sink_)
+			{
+				throw std::runtime_error("Failed to create temporary file for yield curves");
+			}
+		}
+
+		~spill_file()
+		{
+			boost::system::error_code status;
+			sink_.close();
+			boost::filesystem::remove(path_, status);
+		}
+
+		spill_file(spill_file const&) = delete;
+		spill_file& operator=(spill_file const&) = delete;
+
+	public:
+		void write(value_type const* values, size_t count)
+		{
+			sink_.write(reinterpret_cast<char const*>(values), count * sizeof(value_type));
+		}
+
+		/* Completes writing, and maps what was written */
+		std::shared_ptr<mapped_data_file> map()
+		{
+			sink_.close();
+
+			if (sink_.fail())
+			{
+				throw std::runtime_error("Failed to write temporary file for yield curves");
+			}
+
+			return std::make_shared<mapped_data_file>(path_.c_str());
+		}
+
+	private:
+		std::string path_;
+		std::ofstream sink_;
+	};
+
+	/* Moves returns parsed so far to a new spill file, to which later rows are then written */
+	void spill()
+	{
+		spill_.reset(new spill_file());
+		spill_->write(values_.data(), values_.size());
+		std::vector<value_type>().swap(values_);
+	}
+
+	/* Maps returns spilled while parsing (if any) */
+	void map_spill()
+	{
+		if (spill_)
+		{
+			mapped_ = spill_->map();
+			mapped_returns_ = reinterpret_cast<value_type const*>(mapped_->begin());
+		}
+	}
+
+	/* Maps a fresh cache of returns (returning false if none is available) */
+	bool map(cache_type const& cache)
+	{
+		uint64_t rows = 0;
+		uint64_t columns = 0;
+
+		mapped_.reset(cache.map_dense(mapped_returns_, rows, columns));
+
+		if (!mapped_)
+		{
+			return false;
+		}
+
+		check_columns(columns);
+		scenarios_ = rows;
+		columns_ = columns;
+		return true;
+	}
+
+	/* Parses returns from text, either into the given cache writer or (if none) into memory, spilling beyond the limit */
+	void parse(char const* filename, typename cache_type::dense_row_writer* writer)
+	{
+		scenarios_ = stream_dense_data<value_type>(filename, row_sink(*this, writer));
+	}
+
+	void check_columns(size_t columns) const
+	{
+		if ((columns != 1) && (columns < timesteps_))
+		{
+			throw std::runtime_error("Yield scenarios must give either a single return or one return per timestep");
+		}
+	}
+
+	/* Callback for stream_dense_data */
+	class row_sink
+	{
+	public:
+		row_sink(yield_curves& curves, typename cache_type::dense_row_writer* writer) :
+			curves_(curves),
+			writer_(writer)
+		{
+		}
+
+		void operator()(size_t /* row */, value_type const* values, size_t columns)
+		{
+			curves_.check_columns(columns);
+			curves_.columns_ = columns;
+
+			if (writer_ != NULL)
+			{
+				writer_->write(values, columns);
+			}
+			else if (curves_.spill_)
+			{
+				curves_.spill_->write(values, columns);
+			}
+			else
+			{
+				curves_.values_.insert(curves_.values_.end(), values, values + columns);
+
+				if (curves_.values_.size() * sizeof(value_type) > YIELD_CURVE_RESIDENT_BYTES)
+				{
+					curves_.spill();
+				}
+			}
+		}
+
+	private:
+		yield_curves& curves_;
+		typename cache_type::dense_row_writer* writer_;
+	};
+
+private:
+	std::vector<value_type> values_;
+	/* Declared ahead of the mapping, so that a spill file outlives its mapping */
+	std::shared_ptr<spill_file> spill_;
+	std::shared_ptr<mapped_data_file> mapped_;
+	value_type const* mapped_returns_;
+	size_t scenarios_;
+	size_t columns_;
+	size_t timesteps_;
+};
+
+#endif /* !YIELD_CURVES_HPP_ */
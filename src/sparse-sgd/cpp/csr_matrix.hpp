@@ -0,0 +1,130 @@
+#pragma once
+#if !defined(CSR_MATRIX_HPP_)
+#define CSR_MATRIX_HPP_
+
+#include <vector>
+#include <stddef.h>
+
+/* Compressed sparse row matrix: the nonzeros of row i are held contiguously, in ascending column order, at positions */
+/* row_offsets()[i] up to row_offsets()[i + 1] of column_indices() and values() */
+template <typename VALUE_TYPE>
+class csr_matrix
+{
+public:
+	typedef VALUE_TYPE value_type;
+	typedef size_t size_type;
+
+public:
+	csr_matrix() :
+		size1_(0),
+		size2_(0),
+		row_offsets_(1, 0)
+	{
+	}
+
+	/* Converts from any (uBLAS) matrix whose nonzeros iterate in row-major order, e.g., coordinate_matrix */
+	template <class MATRIX_TYPE>
+	explicit csr_matrix(MATRIX_TYPE const& matrix) :
+		size1_(matrix.size1()),
+		size2_(matrix.size2()),
+		row_offsets_(matrix.size1() + 1, 0)
+	{
+		for (typename MATRIX_TYPE::const_iterator1 major = matrix.begin1(); major != matrix.end1(); ++major)
+		{
+			for (typename MATRIX_TYPE::const_iterator2 minor = major.begin(); minor != major.end(); ++minor)
+			{
+				++row_offsets_[minor.index1() + 1];
+				column_indices_.push_back(minor.index2());
+				values_.push_back(*minor);
+			}
+		}
+
+		for (size_type i = 0; i < size1_; ++i)
+		{
+			row_offsets_[i + 1] += row_offsets_[i];
+		}
+	}
+
+public:
+	size_type size1() const
+	{
+		return size1_;
+	}
+
+	size_type size2() const
+	{
+		return size2_;
+	}
+
+	size_type nnz() const
+	{
+		return values_.size();
+	}
+
+	size_type const* row_offsets() const
+	{
+		return &row_offsets_[0];
+	}
+
+	size_type const* column_indices() const
+	{
+		return column_indices_.empty() ? NULL : &column_indices_[0];
+	}
+
+	value_type const* values() const
+	{
+		return values_.empty() ? NULL : &values_[0];
+	}
+
+	/* Values may be rewritten in place, keeping the sparsity pattern */
+	value_type* values()
+	{
+		return values_.empty() ? NULL : &values_[0];
+	}
+
+	/* Transpose (by counting sort, so the nonzeros of each result row stay in ascending column order) */
+	csr_matrix transpose() const
+	{
+		csr_matrix result;
+
+		result.size1_ = size2_;
+		result.size2_ = size1_;
+		result.row_offsets_.assign(size2_ + 1, 0);
+		result.column_indices_.resize(nnz());
+		result.values_.resize(nnz());
+
+		for (size_type k = 0; k < nnz(); ++k)
+		{
+			++result.row_offsets_[column_indices_[k] + 1];
+		}
+
+		for (size_type j = 0; j < size2_; ++j)
+		{
+			result.row_offsets_[j + 1] += result.row_offsets_[j];
+		}
+
+		std::vector<size_type> positions(result.row_offsets_.begin(), result.row_offsets_.end() - 1);
+
+		for (size_type i = 0; i < size1_; ++i)
+		{
+			for (size_type k = row_offsets_[i]; k < row_offsets_[i + 1]; ++k)
+			{
+				size_type position = positions[column_indices_[k]]++;
+
+				result.column_indices_[position] = i;
+				result.values_[position] = values_[k];
+			}
+		}
+
+		return result;
+	}
+
+private:
+	size_type size1_;
+	size_type size2_;
+	std::vector<size_type> row_offsets_;
+	std::vector<size_type> column_indices_;
+	std::vector<value_type> values_;
+};
+
+#endif /* CSR_MATRIX_HPP_ */
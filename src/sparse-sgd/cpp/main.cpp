@@ -2,12 +2,19 @@
 #pragma message("Warning: boost will compiled with checks on non-debug build (NDEBUG should be defined but is not)")
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <type_traits>
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/matrix_sparse.hpp>
 
 #include "matrix_io.hpp"
 #include "matrix_ops.hpp"
+#include "sgd_training.hpp"
 
 #if defined(DEBUG) || defined(_DEBUG) || defined(INCLUDE_MATRIX_DEBUG)
 #include "matrix_debug.hpp"
@@ -15,17 +22,53 @@
 
 #include "profile.hpp"
 #include "profile_config.hpp"
-#include "collector/json.hpp"
+#include "collector/formats.hpp"
+#include "collector/perf_counters.hpp"
 
 using namespace boost;
 using namespace boost::numeric::ublas;
 
+/* Precision of the model: values are stored as SGD_VALUE_TYPE and products are summed as SGD_ACCUMULATOR_TYPE */
+/* (double throughout by default; the float32 and mixed-precision targets store floats, accumulating as float or double) */
+#if !defined(SGD_VALUE_TYPE)
+#define SGD_VALUE_TYPE double
+#endif /* !SGD_VALUE_TYPE */
+
+#if !defined(SGD_ACCUMULATOR_TYPE)
+#define SGD_ACCUMULATOR_TYPE SGD_VALUE_TYPE
+#endif /* !SGD_ACCUMULATOR_TYPE */
+
+/* Largest difference of a reduced-precision step from the double-precision reference, relative to the largest reference magnitude */
+#if !defined(SGD_REFERENCE_TOLERANCE)
+#define SGD_REFERENCE_TOLERANCE 1e-4
+#endif /* !SGD_REFERENCE_TOLERANCE */
+
+/* Hyperparameters of the training modes (each trial is one epoch) */
+static size_t const TRAINING_BATCH_ROWS = 32;
+static double const TRAINING_LEARNING_RATE = 0.5;
+static double const TRAINING_LAMBDA = 0.001;
+
+/* Inputs of a gradient step for V, at a given precision */
+template <typename VALUE_TYPE>
+struct sgd_inputs
+{
+	csr_matrix<VALUE_TYPE> x;
+	csr_matrix<VALUE_TYPE> x_transpose;
+	matrix<VALUE_TYPE> y;
+	matrix<VALUE_TYPE> cross_terms;
+	matrix<VALUE_TYPE> v;
+	matrix<VALUE_TYPE> dv;
+};
+
 class profiler_subject
 {
 protected:
-	typedef double sparse_matrix_double_t;
-	typedef coordinate_matrix<sparse_matrix_double_t> sparse_double_matrix_t;
-	typedef matrix<sparse_matrix_double_t> dense_double_matrix_t;
+	typedef SGD_VALUE_TYPE value_type;
+	typedef SGD_ACCUMULATOR_TYPE accumulator_type;
+	typedef matrix<value_type> dense_matrix_t;
+
+	/* Reduced-precision builds check each step against a double-precision reference */
+	static const bool CHECK_REFERENCE = !std::is_same<value_type, double>::value || !std::is_same<accumulator_type, double>::value;
 
 protected:
 	std::ostream& progress_line(char const* text = NULL)
@@ -53,75 +96,129 @@ protected:
 	}
 
 protected:
-	static void sgd_V(dense_double_matrix_t& result, sparse_double_matrix_t& x, dense_double_matrix_t& total_losses, dense_double_matrix_t& cross_terms, dense_double_matrix_t& v, dense_double_matrix_t const& dv, int k = 10, double alpha = 0.99, double gamma = 0.1, double lambda = 0.1)
+	/* Updates a block of rows of V (each a column of x, i.e., a row of its transpose) in a single pass: the row's xvxl */
+	/* and xxl terms are accumulated from its nonzeros and immediately applied, for a number of factors fixed at compile */
+	/* time (so that accumulation is unrolled and vectorized) or, if FACTORS is zero, given at run time */
+	template <size_t FACTORS, typename ACCUMULATOR_TYPE, typename VALUE_TYPE>
+	static void sgd_V_rows(matrix<VALUE_TYPE>& result, csr_matrix<VALUE_TYPE> const& x_transpose, matrix<VALUE_TYPE> const& total_losses, matrix<VALUE_TYPE> const& cross_terms, matrix<VALUE_TYPE> const& v, matrix<VALUE_TYPE> const& dv, size_t k, ACCUMULATOR_TYPE alpha, ACCUMULATOR_TYPE gamma, ACCUMULATOR_TYPE lambda, size_t first_row, size_t last_row)
 	{
-		double x_row_count_reciprocal = 1.0 / static_cast<double>(x.size1());
+		size_t factors = (FACTORS > 0) ? FACTORS : k;
+		size_t cross_terms_width = cross_terms.size2();
+		ACCUMULATOR_TYPE x_row_count_reciprocal = ACCUMULATOR_TYPE(1) / static_cast<ACCUMULATOR_TYPE>(x_transpose.size2());
+		typename csr_matrix<VALUE_TYPE>::size_type const* row_offsets = x_transpose.row_offsets();
+		typename csr_matrix<VALUE_TYPE>::size_type const* column_indices = x_transpose.column_indices();
+		VALUE_TYPE const* values = x_transpose.values();
+		VALUE_TYPE const* cross_terms_data = &cross_terms.data()[0];
+		std::vector<ACCUMULATOR_TYPE> runtime_xvxl((FACTORS > 0) ? 0 : factors);
+		ACCUMULATOR_TYPE fixed_xvxl[(FACTORS > 0) ? FACTORS : 1];
+		ACCUMULATOR_TYPE* xvxl = (FACTORS > 0) ? fixed_xvxl : runtime_xvxl.data();
+
+		for (size_t row = first_row; row < last_row; ++row)
+		{
+			ACCUMULATOR_TYPE xxl = 0.0;
+
+			std::fill(xvxl, xvxl + factors, ACCUMULATOR_TYPE(0));
 
-		coordinate_matrix<sparse_double_matrix_t::value_type> x_loss(x.size2(), x.size1(), x.nnz());
-		vector<sparse_double_matrix_t::value_type> xxl(x.size2());
+			for (size_t entry = row_offsets[row]; entry < row_offsets[row + 1]; ++entry)
+			{
+				ACCUMULATOR_TYPE xelement = values[entry];
+				ACCUMULATOR_TYPE loss = xelement * static_cast<ACCUMULATOR_TYPE>(total_losses(column_indices[entry], 0));
+				ACCUMULATOR_TYPE weight = loss * x_row_count_reciprocal;
+				VALUE_TYPE const* cross_terms_row = cross_terms_data + column_indices[entry] * cross_terms_width;
 
-		/* Boost documentation says the vector above will be zero-filled, but Microsoft debug builds violate this expectation (std::allocator issue) */
-#if defined(_DEBUG) && defined(_MSC_VER)
-		xxl.clear();
-#endif /* _DEBUG && _MSC_VER */
+				xxl += loss * xelement;
 
-		for (sparse_double_matrix_t::iterator1 major = x.begin1(); major != x.end1(); ++major)
-		{
-			for (sparse_double_matrix_t::iterator2 minor = major.begin(); minor != major.end(); ++minor)
+				for (size_t f = 0; f < factors; ++f)
+				{
+					xvxl[f] += weight * static_cast<ACCUMULATOR_TYPE>(cross_terms_row[f]);
+				}
+			}
+
+			xxl *= x_row_count_reciprocal;
+
+			for (size_t f = 0; f < factors; ++f)
 			{
-				sparse_double_matrix_t::value_type xelement = *minor;
-				sparse_double_matrix_t::value_type loss = xelement * total_losses(minor.index1(), 0);
-				x_loss.append_element(minor.index2(), minor.index1(), loss * x_row_count_reciprocal);
-				xxl[minor.index2()] += loss * xelement;
+				ACCUMULATOR_TYPE vvalue = v(row, f);
+				ACCUMULATOR_TYPE vmodified = vvalue - alpha * ((xvxl[f] - xxl * vvalue) + gamma * static_cast<ACCUMULATOR_TYPE>(dv(row, f)) + lambda * vvalue);
+				result(row, f) = static_cast<VALUE_TYPE>(vvalue - vmodified);
 			}
 		}
+	}
 
-		xxl *= x_row_count_reciprocal;
-
-		dense_double_matrix_t xvxl;
-		matrix_multiply(x_loss, cross_terms, xvxl);
+	/* Gradient step for V, computed straight from the (row-compressed) transpose of x without staging x_loss */
+	template <typename ACCUMULATOR_TYPE, typename VALUE_TYPE>
+	static void sgd_V(matrix<VALUE_TYPE>& result, csr_matrix<VALUE_TYPE> const& x_transpose, matrix<VALUE_TYPE> const& total_losses, matrix<VALUE_TYPE> const& cross_terms, matrix<VALUE_TYPE> const& v, matrix<VALUE_TYPE> const& dv, int k = 10, ACCUMULATOR_TYPE alpha = 0.99, ACCUMULATOR_TYPE gamma = 0.1, ACCUMULATOR_TYPE lambda = 0.1)
+	{
+		size_t factors = static_cast<size_t>(k);
 
-		dense_double_matrix_t v_modified(v);
+		/* Factors beyond k are left unchanged by the step */
+		{
+			TRACE_SPAN("sgd_V_clear");
+			result.resize(v.size1(), v.size2(), false);
+			result.clear();
+		}
 
-		for (size_t f = 0; f < static_cast<size_t>(k); ++f)
+		csr_for_row_blocks(x_transpose, [&](size_t first_row, size_t last_row)
 		{
-			for (size_t i = 0; i < x.size2(); ++i)
+			TRACE_SPAN("sgd_V_rows");
+
+			if (factors == 10)
 			{
-				dense_double_matrix_t::value_type& vref(v_modified.at_element(i, f));
-				vref -= alpha * ((xvxl(i, f) - xxl[i] * vref) + gamma * dv(i, f) + lambda * vref);
+				sgd_V_rows<10>(result, x_transpose, total_losses, cross_terms, v, dv, factors, alpha, gamma, lambda, first_row, last_row);
 			}
-		}
-
-		v_modified *= -1.0;
-		v_modified += v;
-		result.assign_temporary(v_modified);
+			else
+			{
+				sgd_V_rows<0>(result, x_transpose, total_losses, cross_terms, v, dv, factors, alpha, gamma, lambda, first_row, last_row);
+			}
+		});
 	}
 
-	void setup()
+	/* Loads (and derives) the inputs of a gradient step at a given precision, reporting progress if verbose */
+	template <typename ACCUMULATOR_TYPE, typename VALUE_TYPE>
+	void load_inputs(sgd_inputs<VALUE_TYPE>& inputs, bool verbose)
 	{
 		static char const* dense_load_status = "loaded from dense (tabular) datafile";
 		static char const* computed_status = "computed";
 
-		progress_line("preparing data...") << std::endl;
+		TRACE_SPAN("load_inputs");
+		coordinate_matrix<VALUE_TYPE> x;
+		load_cartesian_data(x, "x_sparse_1.csv", "x_sparse_2.csv");
+		report_progress(verbose, x, "x", "loaded from sparse (coordinate) datafile");
 
-		load_cartesian_data(x_, "x_sparse_1.csv", "x_sparse_2.csv");
-		emit_progress(x_, "x", "loaded from sparse (coordinate) datafile");
+		/* Compressed rows of x (for cross terms) and of its transpose (for each gradient step) are used by the CSR kernels */
+		inputs.x = csr_matrix<VALUE_TYPE>(x);
+		inputs.x_transpose = inputs.x.transpose();
 
-		load_dense_data(y_, "y.csv");
-		emit_progress(y_, "y", dense_load_status);
+		load_dense_data(inputs.y, "y.csv");
+		report_progress(verbose, inputs.y, "y", dense_load_status);
 		
-		dense_double_matrix_t v;
+		matrix<VALUE_TYPE> v;
 		load_dense_data(v, "v1.csv");
-		emit_progress(v, "v[temp]", dense_load_status);
+		report_progress(verbose, v, "v[temp]", dense_load_status);
 
-		matrix_multiply(x_, v, cross_terms_);
-		emit_progress(cross_terms_, "cross-terms", computed_status);
+		matrix_multiply<ACCUMULATOR_TYPE>(inputs.x, v, inputs.cross_terms);
+		report_progress(verbose, inputs.cross_terms, "cross-terms", computed_status);
 
-		load_dense_data(v_, "v.csv");
-		emit_progress(v_, "v", dense_load_status);
+		load_dense_data(inputs.v, "v.csv");
+		report_progress(verbose, inputs.v, "v", dense_load_status);
 
-		load_dense_data(dv_, "dv.csv");
-		emit_progress(dv_, "dv", dense_load_status);
+		load_dense_data(inputs.dv, "dv.csv");
+		report_progress(verbose, inputs.dv, "dv", dense_load_status);
+	}
+
+	void setup()
+	{
+		progress_line("preparing data...") << std::endl;
+		load_inputs<accumulator_type>(inputs_, true);
+
+		if (CHECK_REFERENCE)
+		{
+			sgd_inputs<double> reference_inputs;
+
+			progress_line("computing double-precision reference step...") << std::endl;
+			load_inputs<double>(reference_inputs, false);
+			sgd_V<double>(reference_, reference_inputs.x_transpose, reference_inputs.y, reference_inputs.cross_terms, reference_inputs.v, reference_inputs.dv);
+		}
 	}
 
 	void begin_sample(int trial)
@@ -131,12 +228,18 @@ protected:
 
 	void sample(int trial)
 	{
-		sgd_V(result_, x_, y_, cross_terms_, v_, dv_);
+		sgd_V<accumulator_type>(result_, inputs_.x_transpose, inputs_.y, inputs_.cross_terms, inputs_.v, inputs_.dv);
 	}
 
 	void end_sample(int trial)
 	{
 		emit_progress(result_, "result", "computed");
+
+		if (CHECK_REFERENCE)
+		{
+			check_reference();
+		}
+
 		progress_line() << "completed trial #" << trial << "..." << std::endl;
 	}
 
@@ -146,25 +249,178 @@ protected:
 	}
 
 private:
-	sparse_double_matrix_t x_;
-	dense_double_matrix_t y_;
-	dense_double_matrix_t v_;
-	dense_double_matrix_t cross_terms_;
-	dense_double_matrix_t dv_;
-	dense_double_matrix_t result_;
+	template <class MATRIX_TYPE>
+	void report_progress(bool verbose, MATRIX_TYPE const& matrix, char const* name, char const* status)
+	{
+		if (verbose)
+		{
+			emit_progress(matrix, name, status);
+		}
+	}
+
+	/* Compares the result with the double-precision reference, throwing if it differs by more than the tolerance */
+	void check_reference()
+	{
+		TRACE_SPAN("check_reference");
+		double largest_difference = 0.0;
+		double largest_magnitude = 0.0;
+
+		for (size_t i = 0; i < reference_.size1(); ++i)
+		{
+			for (size_t j = 0; j < reference_.size2(); ++j)
+			{
+				largest_difference = std::max(largest_difference, std::abs(static_cast<double>(result_(i, j)) - reference_(i, j)));
+				largest_magnitude = std::max(largest_magnitude, std::abs(reference_(i, j)));
+			}
+		}
+
+		double relative_difference = (largest_magnitude > 0.0) ? largest_difference / largest_magnitude : largest_difference;
+
+		progress_line() << "result differs from double-precision reference by " << relative_difference << " (relative to largest magnitude)" << std::endl;
+
+		if (!(relative_difference <= SGD_REFERENCE_TOLERANCE))
+		{
+			std::ostringstream message;
+			message << "Result differs from double-precision reference by " << relative_difference << ", beyond tolerance of " << SGD_REFERENCE_TOLERANCE;
+			throw std::runtime_error(message.str());
+		}
+	}
+
+public:
+	/* Floating-point operations of a gradient step: per nonzero of x, its loss, weight and xxl term and the factors' xvxl */
+	/* terms, and per row of V, the scaling of its xxl term and the update of each factor */
+	double sample_flops() const
+	{
+		double factors = static_cast<double>(inputs_.v.size2());
+		return inputs_.x_transpose.nnz() * (4.0 + 2.0 * factors) + inputs_.x_transpose.size1() * (1.0 + 9.0 * factors);
+	}
+
+protected:
+	sgd_inputs<value_type> inputs_;
+
+private:
+	dense_matrix_t result_;
+	matrix<double> reference_;
+};
+
+/* Trains V from its loaded value by mini-batch SGD over the loaded x and y, one epoch per trial, reporting each epoch's */
+/* throughput (nonzeros of x visited per second) and mean squared error as per-trial metrics */
+/* Training runs Hogwild-style across threads unless deterministic, in which case it runs on one thread */
+template <class COLLECTOR>
+class training_subject : protected profiler_subject
+{
+protected:
+	typedef factorization_trainer<value_type, accumulator_type> trainer_type;
+
+protected:
+	training_subject(COLLECTOR& collector, uint64_t seed, size_t threads, bool deterministic) :
+		collector_(collector),
+		seed_(seed),
+		threads_(deterministic ? 1 : threads),
+		epoch_time_(0)
+	{
+	}
+
+protected:
+	void setup()
+	{
+		trainer_type::parameters settings = { TRAINING_BATCH_ROWS, TRAINING_LEARNING_RATE, TRAINING_LAMBDA };
+
+		progress_line("preparing data...") << std::endl;
+		load_inputs<accumulator_type>(inputs_, true);
+
+		trainer_.reset(new trainer_type(inputs_.x, &inputs_.y.data()[0], &inputs_.v.data()[0], inputs_.v.size2(), settings, seed_, threads_));
+		progress_line() << "training on " << trainer_->thread_count() << " thread(s) from mean squared error " << trainer_->mean_squared_error() << "..." << std::endl;
+	}
+
+	void begin_sample(int trial)
+	{
+		progress_line() << "starting epoch #" << trial << "..." << std::endl;
+	}
+
+	void sample(int trial)
+	{
+		boost::chrono::high_resolution_clock::time_point t0 = boost::chrono::high_resolution_clock::now();
+
+		trainer_->run_epoch(static_cast<size_t>(trial));
+		epoch_time_ = boost::chrono::duration_cast<typename COLLECTOR::time_unit>(boost::chrono::high_resolution_clock::now() - t0);
+	}
+
+	void end_sample(int trial)
+	{
+		double seconds = boost::chrono::duration<double>(epoch_time_).count();
+		double throughput = (seconds > 0.0) ? trainer_->nnz() / seconds : 0.0;
+		double error = 0.0;
+
+		{
+			TRACE_SPAN("mean_squared_error");
+			error = trainer_->mean_squared_error();
+		}
+
+		collector_.register_trial_metric("epoch_nonzeros_per_second", throughput);
+		collector_.register_trial_metric("epoch_mean_squared_error", error);
+		progress_line() << "completed epoch #" << trial << " (" << throughput << " nonzeros/s, mean squared error " << error << ")..." << std::endl;
+	}
+
+	/* Trained factors are reported (and dumped, where enabled) like the result of a gradient step */
+	void teardown()
+	{
+		dense_matrix_t trained(inputs_.v.size1(), inputs_.v.size2());
+
+		trainer_->copy_factors(&trained.data()[0]);
+		emit_progress(trained, "v", "trained");
+		profiler_subject::teardown();
+	}
+
+private:
+	COLLECTOR& collector_;
+	uint64_t seed_;
+	size_t threads_;
+	std::unique_ptr<trainer_type> trainer_;
+	typename COLLECTOR::time_unit epoch_time_;
 };
 
 int main(int argc, char* argv[])
 {
 	int result = 0;
-	json_output collector;
 	argv_collection arguments(argc - 1, argv + 1);
 	
 	try
 	{
 		profile_config<argv_collection::const_iterator> config(arguments.begin(), arguments.end());
-		profiler<profiler_subject, json_output> metrics(config.get_trial_count(), collector);
-		metrics.run();
+
+		/* Binary caches of parsed inputs are only kept when a cache directory is given */
+		matrix_cache_directory() = config.get_cache_directory();
+
+		std::string mode = config.get_mode().empty() ? std::string("step") : config.get_mode();
+
+		/* Modes: step (default) times one gradient step for V, while train and train-deterministic train V over epochs */
+		if ((mode != "step") && (mode != "train") && (mode != "train-deterministic"))
+		{
+			throw std::invalid_argument("Argument error for mode: invalid argument value (expected step, train, or train-deterministic)");
+		}
+
+		/* Results are reported by the collector for the chosen format, with the mode naming the benchmark */
+		with_collector(config.get_format(), "sparse-sgd/" + mode, [&](auto& collector)
+		{
+			typedef typename std::decay<decltype(collector)>::type collector_type;
+
+			if (mode == "step")
+			{
+				run_profiler<profiler_subject>(config.get_sampling_policy(), config.get_counters(), collector);
+			}
+			else
+			{
+				std::cerr << "[PROGRESS] using seed " << config.get_seed() << " (replay with --seed)" << std::endl;
+
+				run_profiler<training_subject<collector_type> >(config.get_sampling_policy(), config.get_counters(), collector, std::ref(collector), config.get_seed(), config.get_thread_count(), mode == "train-deterministic");
+			}
+		});
+
+		if (!config.get_trace_path().empty())
+		{
+			write_trace(config.get_trace_path());
+		}
 	}
 	catch (std::exception const& e)
 	{
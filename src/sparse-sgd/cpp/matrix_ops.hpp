@@ -2,9 +2,20 @@
 #if !defined(MATRIX_OPS_HPP_)
 #define MATRIX_OPS_HPP_
 
+#include <algorithm>
+#include <thread>
+#include <vector>
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/matrix_proxy.hpp>
 
+#include "csr_matrix.hpp"
+#include "trace.hpp"
+
+/* Fewest nonzeros for which the CSR kernel splits rows across threads */
+#if !defined(CSR_PARALLEL_NNZ)
+#define CSR_PARALLEL_NNZ (size_t(1) << 16)
+#endif /* !CSR_PARALLEL_NNZ */
+
 /* Performance traits for Boost matrix types */
 template <typename VALUE_TYPE, class MATRIX_TEMPLATE_TYPE>
 class matrix_performance_traits
@@ -12,6 +23,7 @@ class matrix_performance_traits
 public:
 	static const bool fast_iterating = false;
 	static const bool fast_indexing = false;
+	static const bool compressed_rows = false;
 };
 
 /* Specialization for coordinate_matrix performance traits */
@@ -21,6 +33,7 @@ class matrix_performance_traits<VALUE_TYPE, boost::numeric::ublas::coordinate_ma
 public:
 	static const bool fast_iterating = true;
 	static const bool fast_indexing = false;
+	static const bool compressed_rows = false;
 };
 
 /* Specialization for (dense) matrix performance traits */
@@ -30,45 +43,208 @@ class matrix_performance_traits<VALUE_TYPE, boost::numeric::ublas::matrix<VALUE_
 public:
 	static const bool fast_iterating = true;
 	static const bool fast_indexing = true;
+	static const bool compressed_rows = false;
 };
 
+/* Specialization for CSR matrix performance traits */
+template <typename VALUE_TYPE>
+class matrix_performance_traits<VALUE_TYPE, csr_matrix<VALUE_TYPE>>
+{
+public:
+	static const bool fast_iterating = true;
+	static const bool fast_indexing = false;
+	static const bool compressed_rows = true;
+};
+
+/* Scratch sums for rows of a width given at run time, reused across rows by each thread */
+template <typename ACCUMULATOR_TYPE>
+std::vector<ACCUMULATOR_TYPE>& csr_multiply_sums()
+{
+	static thread_local std::vector<ACCUMULATOR_TYPE> sums;
+	return sums;
+}
+
+/* CSR by dense (row-major) multiplication of a block of rows, for a result width fixed at compile time (so that the */
+/* accumulation over each result row is unrolled and vectorized) or, if WIDTH is zero, given at run time */
+/* Products are summed in the accumulator type (which may be wider than the value type) before being stored */
+template <size_t WIDTH, typename ACCUMULATOR_TYPE, typename VALUE_TYPE>
+void csr_multiply_rows(csr_matrix<VALUE_TYPE> const& matrix1, VALUE_TYPE const* matrix2, size_t width, VALUE_TYPE* result, size_t first_row, size_t last_row)
+{
+	typename csr_matrix<VALUE_TYPE>::size_type const* row_offsets = matrix1.row_offsets();
+	typename csr_matrix<VALUE_TYPE>::size_type const* column_indices = matrix1.column_indices();
+	VALUE_TYPE const* values = matrix1.values();
+
+	for (size_t row = first_row; row < last_row; ++row)
+	{
+		VALUE_TYPE* result_row = result + row * width;
+
+		if (WIDTH > 0)
+		{
+			/* Sums are held locally, so they needn't be reloaded for each nonzero */
+			ACCUMULATOR_TYPE sums[WIDTH > 0 ? WIDTH : 1] = {};
+
+			for (size_t k = row_offsets[row]; k < row_offsets[row + 1]; ++k)
+			{
+				ACCUMULATOR_TYPE multiplier = values[k];
+				VALUE_TYPE const* matrix2_row = matrix2 + column_indices[k] * WIDTH;
+
+				for (size_t i = 0; i < WIDTH; ++i)
+				{
+					sums[i] += multiplier * static_cast<ACCUMULATOR_TYPE>(matrix2_row[i]);
+				}
+			}
+
+			for (size_t i = 0; i < WIDTH; ++i)
+			{
+				result_row[i] = static_cast<VALUE_TYPE>(sums[i]);
+			}
+		}
+		else
+		{
+			std::vector<ACCUMULATOR_TYPE>& sums = csr_multiply_sums<ACCUMULATOR_TYPE>();
+
+			sums.assign(width, ACCUMULATOR_TYPE(0));
+
+			for (size_t k = row_offsets[row]; k < row_offsets[row + 1]; ++k)
+			{
+				ACCUMULATOR_TYPE multiplier = values[k];
+				VALUE_TYPE const* matrix2_row = matrix2 + column_indices[k] * width;
+
+				for (size_t i = 0; i < width; ++i)
+				{
+					sums[i] += multiplier * static_cast<ACCUMULATOR_TYPE>(matrix2_row[i]);
+				}
+			}
+
+			for (size_t i = 0; i < width; ++i)
+			{
+				result_row[i] = static_cast<VALUE_TYPE>(sums[i]);
+			}
+		}
+	}
+}
+
+/* Dispatches a block of rows to the kernel for the result width (specialized for common narrow widths) */
+template <typename ACCUMULATOR_TYPE, typename VALUE_TYPE>
+void csr_multiply_block(csr_matrix<VALUE_TYPE> const& matrix1, VALUE_TYPE const* matrix2, size_t width, VALUE_TYPE* result, size_t first_row, size_t last_row)
+{
+	switch (width)
+	{
+	case 1: csr_multiply_rows<1, ACCUMULATOR_TYPE>(matrix1, matrix2, width, result, first_row, last_row); break;
+	case 2: csr_multiply_rows<2, ACCUMULATOR_TYPE>(matrix1, matrix2, width, result, first_row, last_row); break;
+	case 4: csr_multiply_rows<4, ACCUMULATOR_TYPE>(matrix1, matrix2, width, result, first_row, last_row); break;
+	case 8: csr_multiply_rows<8, ACCUMULATOR_TYPE>(matrix1, matrix2, width, result, first_row, last_row); break;
+	case 10: csr_multiply_rows<10, ACCUMULATOR_TYPE>(matrix1, matrix2, width, result, first_row, last_row); break;
+	case 16: csr_multiply_rows<16, ACCUMULATOR_TYPE>(matrix1, matrix2, width, result, first_row, last_row); break;
+	default: csr_multiply_rows<0, ACCUMULATOR_TYPE>(matrix1, matrix2, width, result, first_row, last_row); break;
+	}
+}
+
+/* Applies a function to blocks of rows (first_row, last_row) of a CSR matrix, split into blocks of roughly equal */
+/* nonzeros across threads when the matrix is large enough (or as a single block otherwise) */
+template <typename VALUE_TYPE, class FUNCTION>
+void csr_for_row_blocks(csr_matrix<VALUE_TYPE> const& matrix, FUNCTION const& function)
+{
+	size_t threads = (matrix.nnz() >= CSR_PARALLEL_NNZ) ? std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), matrix.size1()) : 1;
+
+	if (threads <= 1)
+	{
+		function(size_t(0), matrix.size1());
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	typename csr_matrix<VALUE_TYPE>::size_type const* row_offsets = matrix.row_offsets();
+	size_t first_row = 0;
+
+	for (size_t worker = 1; worker <= threads; ++worker)
+	{
+		/* Each block ends at the first row boundary reaching its share of nonzeros */
+		size_t last_row = (worker == threads) ? matrix.size1() : static_cast<size_t>(std::lower_bound(row_offsets, row_offsets + matrix.size1() + 1, matrix.nnz() * worker / threads) - row_offsets);
+
+		last_row = std::max(first_row, std::min(last_row, matrix.size1()));
+		workers.push_back(std::thread(function, first_row, last_row));
+		first_row = last_row;
+	}
+
+	for (size_t worker = 0; worker < workers.size(); ++worker)
+	{
+		workers[worker].join();
+	}
+}
+
+/* CSR by dense multiplication, in parallel row blocks when large enough */
+template <typename ACCUMULATOR_TYPE, typename VALUE_TYPE, class MATRIX_2_TYPE, class MATRIX_RESULT_TYPE>
+void csr_multiply(csr_matrix<VALUE_TYPE> const& matrix1, MATRIX_2_TYPE const& matrix2, MATRIX_RESULT_TYPE& result)
+{
+	size_t width = matrix2.size2();
+
+	if ((result.size1() == 0) || (width == 0))
+	{
+		return;
+	}
+
+	VALUE_TYPE const* matrix2_data = &matrix2.data()[0];
+	VALUE_TYPE* result_data = &result.data()[0];
+
+	csr_for_row_blocks(matrix1, [&](size_t first_row, size_t last_row)
+	{
+		TRACE_SPAN("csr_multiply_block");
+		csr_multiply_block<ACCUMULATOR_TYPE>(matrix1, matrix2_data, width, result_data, first_row, last_row);
+	});
+}
+
 /* Matrix multiplication helper with overridden logic driven by performance traits */
-template <class MATRIX_1_TYPE, class MATRIX_2_TYPE, class MATRIX_RESULT_TYPE>
+/* Products are summed in the given accumulator type by the CSR kernel (other paths accumulate in the result matrix) */
+template <typename ACCUMULATOR_TYPE, class MATRIX_1_TYPE, class MATRIX_2_TYPE, class MATRIX_RESULT_TYPE>
 void matrix_multiply(MATRIX_1_TYPE const& matrix1, MATRIX_2_TYPE& matrix2, MATRIX_RESULT_TYPE& result)
 {
 	/* Prepare result storage */
 	result.resize(matrix1.size1(), matrix2.size2());
 
-	/* Optimize if the first matrix is efficiently iterable and the second matrix is efficiently indexable */
-	if (matrix_performance_traits<typename MATRIX_1_TYPE::value_type, MATRIX_1_TYPE>::fast_iterating && matrix_performance_traits<typename MATRIX_2_TYPE::value_type, MATRIX_2_TYPE>::fast_indexing)
+	/* Use the CSR kernel if the first matrix has compressed rows and the second and result matrices are dense */
+	if constexpr (matrix_performance_traits<typename MATRIX_1_TYPE::value_type, MATRIX_1_TYPE>::compressed_rows && matrix_performance_traits<typename MATRIX_2_TYPE::value_type, MATRIX_2_TYPE>::fast_indexing && matrix_performance_traits<typename MATRIX_RESULT_TYPE::value_type, MATRIX_RESULT_TYPE>::fast_indexing)
 	{
-		/* Boost documentation says the resized result matrix will be zero-filled, but Microsoft debug builds violate this expectation (std::allocator issue) */
-#if defined(_DEBUG) && defined(_MSC_VER)
-		result.clear();
-#endif /* _DEBUG && _MSC_VER */
-
-		/* Iterate over (presumably sparse) first-matrix elements and apply to associated result row by multiplying by second-matrix row */
-		for (typename MATRIX_1_TYPE::const_iterator1 major = matrix1.begin1(); major != matrix1.end1(); ++major)
+		csr_multiply<ACCUMULATOR_TYPE>(matrix1, matrix2, result);
+	}
+	else
+	{
+		/* Optimize if the first matrix is efficiently iterable and the second matrix is efficiently indexable */
+		if (matrix_performance_traits<typename MATRIX_1_TYPE::value_type, MATRIX_1_TYPE>::fast_iterating && matrix_performance_traits<typename MATRIX_2_TYPE::value_type, MATRIX_2_TYPE>::fast_indexing)
 		{
-			for (typename MATRIX_1_TYPE::const_iterator2 minor = major.begin(); minor != major.end(); ++minor)
+			/* Boost documentation says the resized result matrix will be zero-filled, but storage for trivial types is left uninitialized (recycled heap memory is not zero) */
+			result.clear();
+
+			/* Iterate over (presumably sparse) first-matrix elements and apply to associated result row by multiplying by second-matrix row */
+			for (typename MATRIX_1_TYPE::const_iterator1 major = matrix1.begin1(); major != matrix1.end1(); ++major)
 			{
-				typename MATRIX_1_TYPE::value_type multiplier(*minor);
+				for (typename MATRIX_1_TYPE::const_iterator2 minor = major.begin(); minor != major.end(); ++minor)
+				{
+					typename MATRIX_1_TYPE::value_type multiplier(*minor);
 
-				boost::numeric::ublas::matrix_row<MATRIX_2_TYPE> matrix2_row(matrix2, minor.index2());
-				boost::numeric::ublas::matrix_row<MATRIX_RESULT_TYPE> result_row(result, minor.index1());
+					boost::numeric::ublas::matrix_row<MATRIX_2_TYPE> matrix2_row(matrix2, minor.index2());
+					boost::numeric::ublas::matrix_row<MATRIX_RESULT_TYPE> result_row(result, minor.index1());
 
-				for (typename MATRIX_2_TYPE::size_type i = 0; i < matrix2.size2(); ++i)
-				{
-					result_row(i) += multiplier * matrix2_row(i);
+					for (typename MATRIX_2_TYPE::size_type i = 0; i < matrix2.size2(); ++i)
+					{
+						result_row(i) += multiplier * matrix2_row(i);
+					}
 				}
 			}
+
+			return;
 		}
 
-		return;
+		/* Default to Boost matrix multiplication implementation */
+		result.assign(boost::numeric::ublas::prod(matrix1, matrix2));
 	}
+}
 
-	/* Default to Boost matrix multiplication implementation */
-	result.assign(boost::numeric::ublas::prod(matrix1, matrix2));
+/* As above, accumulating in the value type of the result matrix */
+template <class MATRIX_1_TYPE, class MATRIX_2_TYPE, class MATRIX_RESULT_TYPE>
+void matrix_multiply(MATRIX_1_TYPE const& matrix1, MATRIX_2_TYPE& matrix2, MATRIX_RESULT_TYPE& result)
+{
+	matrix_multiply<typename MATRIX_RESULT_TYPE::value_type>(matrix1, matrix2, result);
 }
 
 #endif /* MATRIX_OPS_HPP_ */
@@ -0,0 +1,327 @@
+#pragma once
+#if !defined(SGD_TRAINING_HPP_)
+#define SGD_TRAINING_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "csr_matrix.hpp"
+#include "matrix_ops.hpp"
+#include "trace.hpp"
+
+/* Mini-batch SGD training of the factors V of a factorization machine's pairwise term, whose prediction for row i of x */
+/* is half the sum over factors f of (x_i . v_f)^2 - (x_i^2 . v_f^2), under squared loss with L2 regularization of V */
+/* The cross terms x_i . v_f are kept up to date incrementally: each update to a row of V is propagated to the rows of x */
+/* sharing its column (through the transpose of x), and all are recomputed once per epoch, discarding accumulated */
+/* rounding and any updates lost to races */
+/* Workers claim mini-batches of shuffled rows and update V and the cross terms without locks (in the style of Hogwild), */
+/* so with several workers results vary from run to run; with one worker, training is reproducible for a given seed */
+/* Predictions, gradients and cross terms are summed in the accumulator type, which may be wider than the value type */
+template <typename VALUE_TYPE, typename ACCUMULATOR_TYPE = VALUE_TYPE>
+class factorization_trainer
+{
+public:
+	typedef VALUE_TYPE value_type;
+	typedef ACCUMULATOR_TYPE accumulator_type;
+	typedef csr_matrix<value_type> matrix_type;
+
+	/* Training hyperparameters */
+	struct parameters
+	{
+		size_t batch_rows;
+		accumulator_type learning_rate;
+		accumulator_type lambda;
+	};
+
+public:
+	/* Trains factors initialized from v (row-major, one row per column of x) against targets y (one per row of x) */
+	factorization_trainer(matrix_type const& x, value_type const* y, value_type const* v, size_t factors, parameters const& settings, uint64_t seed, size_t threads = 0) :
+		x_(x),
+		x_transpose_(x.transpose()),
+		y_(y, y + x.size1()),
+		factors_(factors),
+		settings_(settings),
+		seed_(seed),
+		threads_((threads > 0) ? threads : std::max(1u, std::thread::hardware_concurrency())),
+		v_(new std::atomic<value_type>[x.size2() * factors]),
+		cross_terms_(new std::atomic<value_type>[x.size1() * factors]),
+		order_(x.size1()),
+		scratch_(threads_)
+	{
+		settings_.batch_rows = std::max<size_t>(1, settings_.batch_rows);
+
+		for (size_t i = 0; i < x_.size2() * factors_; ++i)
+		{
+			store(v_[i], v[i]);
+		}
+
+		for (size_t i = 0; i < order_.size(); ++i)
+		{
+			order_[i] = i;
+		}
+
+		for (size_t worker = 0; worker < threads_; ++worker)
+		{
+			scratch_[worker].gradient.assign(x_.size2() * factors_, accumulator_type(0));
+			scratch_[worker].marked.assign(x_.size2(), 0);
+			scratch_[worker].delta.assign(factors_, accumulator_type(0));
+		}
+
+		resynchronize();
+	}
+
+public:
+	size_t thread_count() const
+	{
+		return threads_;
+	}
+
+	/* Nonzeros of x visited by each epoch */
+	size_t nnz() const
+	{
+		return x_.nnz();
+	}
+
+	/* Runs one epoch over shuffled mini-batches of rows (epochs are numbered so that each has its own shuffle) */
+	void run_epoch(size_t epoch)
+	{
+		std::seed_seq sequence = { static_cast<uint32_t>(seed_), static_cast<uint32_t>(seed_ >> 32), static_cast<uint32_t>(epoch) };
+		std::mt19937_64 shuffler(sequence);
+		size_t batches = (x_.size1() + settings_.batch_rows - 1) / settings_.batch_rows;
+		size_t workers = std::min(threads_, batches);
+		std::atomic<size_t> next_batch(0);
+
+		{
+			TRACE_SPAN("shuffle");
+			std::shuffle(order_.begin(), order_.end(), shuffler);
+		}
+
+		if (workers <= 1)
+		{
+			work(0, batches, next_batch);
+		}
+		else
+		{
+			std::vector<std::thread> threads;
+			threads.reserve(workers);
+
+			for (size_t worker = 0; worker < workers; ++worker)
+			{
+				threads.push_back(std::thread([&, worker]() { work(worker, batches, next_batch); }));
+			}
+
+			for (size_t worker = 0; worker < workers; ++worker)
+			{
+				threads[worker].join();
+			}
+		}
+
+		resynchronize();
+	}
+
+	/* Mean squared error of predictions over all rows of x */
+	double mean_squared_error() const
+	{
+		double total = 0.0;
+
+		for (size_t row = 0; row < x_.size1(); ++row)
+		{
+			double residual = predict(row) - y_[row];
+			total += residual * residual;
+		}
+
+		return (x_.size1() > 0) ? total / x_.size1() : 0.0;
+	}
+
+	/* Copies the factors out (row-major, one row per column of x) */
+	void copy_factors(value_type* v) const
+	{
+		for (size_t i = 0; i < x_.size2() * factors_; ++i)
+		{
+			v[i] = load(v_[i]);
+		}
+	}
+
+private:
+	/* Per-worker gradient accumulator, covering only the rows of V touched by the current mini-batch */
+	struct scratch
+	{
+		std::vector<accumulator_type> gradient;
+		std::vector<unsigned char> marked;
+		std::vector<size_t> touched;
+		std::vector<accumulator_type> delta;
+	};
+
+	/* Shared values are accessed with relaxed atomics, which compile to plain loads and stores */
+	static value_type load(std::atomic<value_type> const& value)
+	{
+		return value.load(std::memory_order_relaxed);
+	}
+
+	static void store(std::atomic<value_type>& value, value_type update)
+	{
+		value.store(update, std::memory_order_relaxed);
+	}
+
+	accumulator_type predict(size_t row) const
+	{
+		typename matrix_type::size_type const* row_offsets = x_.row_offsets();
+		typename matrix_type::size_type const* column_indices = x_.column_indices();
+		value_type const* values = x_.values();
+		accumulator_type sum = 0;
+
+		for (size_t f = 0; f < factors_; ++f)
+		{
+			accumulator_type cross_term = load(cross_terms_[row * factors_ + f]);
+			sum += cross_term * cross_term;
+		}
+
+		for (size_t entry = row_offsets[row]; entry < row_offsets[row + 1]; ++entry)
+		{
+			accumulator_type xsquared = static_cast<accumulator_type>(values[entry]) * values[entry];
+			std::atomic<value_type> const* v_row = &v_[column_indices[entry] * factors_];
+
+			for (size_t f = 0; f < factors_; ++f)
+			{
+				accumulator_type factor = load(v_row[f]);
+				sum -= xsquared * factor * factor;
+			}
+		}
+
+		return accumulator_type(0.5) * sum;
+	}
+
+	/* Worker loop, accumulating the gradient of each claimed mini-batch and then applying it row by row of V */
+	void work(size_t worker, size_t batches, std::atomic<size_t>& next_batch)
+	{
+		typename matrix_type::size_type const* row_offsets = x_.row_offsets();
+		typename matrix_type::size_type const* column_indices = x_.column_indices();
+		value_type const* values = x_.values();
+		typename matrix_type::size_type const* transpose_offsets = x_transpose_.row_offsets();
+		typename matrix_type::size_type const* transpose_indices = x_transpose_.column_indices();
+		value_type const* transpose_values = x_transpose_.values();
+		scratch& local = scratch_[worker];
+
+		TRACE_SPAN("train_batches");
+
+		for (size_t batch = next_batch++; batch < batches; batch = next_batch++)
+		{
+			size_t first = batch * settings_.batch_rows;
+			size_t last = std::min(x_.size1(), first + settings_.batch_rows);
+
+			for (size_t position = first; position < last; ++position)
+			{
+				size_t row = order_[position];
+				accumulator_type residual = predict(row) - y_[row];
+				std::atomic<value_type> const* cross_terms_row = &cross_terms_[row * factors_];
+
+				for (size_t entry = row_offsets[row]; entry < row_offsets[row + 1]; ++entry)
+				{
+					size_t column = column_indices[entry];
+					accumulator_type xelement = values[entry];
+					accumulator_type* gradient = &local.gradient[column * factors_];
+					std::atomic<value_type> const* v_row = &v_[column * factors_];
+
+					if (!local.marked[column])
+					{
+						local.marked[column] = 1;
+						local.touched.push_back(column);
+					}
+
+					for (size_t f = 0; f < factors_; ++f)
+					{
+						gradient[f] += residual * (xelement * static_cast<accumulator_type>(load(cross_terms_row[f])) - xelement * xelement * static_cast<accumulator_type>(load(v_row[f])));
+					}
+				}
+			}
+
+			accumulator_type step = settings_.learning_rate / static_cast<accumulator_type>(last - first);
+
+			for (size_t i = 0; i < local.touched.size(); ++i)
+			{
+				size_t column = local.touched[i];
+				accumulator_type* gradient = &local.gradient[column * factors_];
+				std::atomic<value_type>* v_row = &v_[column * factors_];
+
+				for (size_t f = 0; f < factors_; ++f)
+				{
+					accumulator_type factor = load(v_row[f]);
+
+					local.delta[f] = -(step * gradient[f] + settings_.learning_rate * settings_.lambda * factor);
+					store(v_row[f], static_cast<value_type>(factor + local.delta[f]));
+					gradient[f] = 0;
+				}
+
+				/* Propagate the update to the cross terms of every row of x with a nonzero in this column */
+				for (size_t entry = transpose_offsets[column]; entry < transpose_offsets[column + 1]; ++entry)
+				{
+					std::atomic<value_type>* cross_terms_row = &cross_terms_[transpose_indices[entry] * factors_];
+					accumulator_type xelement = transpose_values[entry];
+
+					for (size_t f = 0; f < factors_; ++f)
+					{
+						store(cross_terms_row[f], static_cast<value_type>(load(cross_terms_row[f]) + xelement * local.delta[f]));
+					}
+				}
+
+				local.marked[column] = 0;
+			}
+
+			local.touched.clear();
+		}
+	}
+
+	/* Recomputes every cross term from V (in parallel row blocks when large enough) */
+	void resynchronize()
+	{
+		csr_for_row_blocks(x_, [this](size_t first_row, size_t last_row)
+		{
+			TRACE_SPAN("resynchronize");
+			typename matrix_type::size_type const* row_offsets = x_.row_offsets();
+			typename matrix_type::size_type const* column_indices = x_.column_indices();
+			value_type const* values = x_.values();
+			std::vector<accumulator_type> sums(factors_);
+
+			for (size_t row = first_row; row < last_row; ++row)
+			{
+				std::fill(sums.begin(), sums.end(), accumulator_type(0));
+
+				for (size_t entry = row_offsets[row]; entry < row_offsets[row + 1]; ++entry)
+				{
+					std::atomic<value_type> const* v_row = &v_[column_indices[entry] * factors_];
+
+					for (size_t f = 0; f < factors_; ++f)
+					{
+						sums[f] += static_cast<accumulator_type>(values[entry]) * load(v_row[f]);
+					}
+				}
+
+				for (size_t f = 0; f < factors_; ++f)
+				{
+					store(cross_terms_[row * factors_ + f], static_cast<value_type>(sums[f]));
+				}
+			}
+		});
+	}
+
+private:
+	matrix_type x_;
+	matrix_type x_transpose_;
+	std::vector<value_type> y_;
+	size_t factors_;
+	parameters settings_;
+	uint64_t seed_;
+	size_t threads_;
+	std::unique_ptr<std::atomic<value_type>[]> v_;
+	std::unique_ptr<std::atomic<value_type>[]> cross_terms_;
+	std::vector<size_t> order_;
+	std::vector<scratch> scratch_;
+};
+
+#endif /* SGD_TRAINING_HPP_ */